@@ -1,6 +1,20 @@
 #ifndef BF_ALL_HPP
 #define BF_ALL_HPP
 
+#include "bf/archive.hpp"
+#include "bf/bit_sliced_index.hpp"
 #include "bf/bloom_filter/basic.hpp"
+#include "bf/bloom_filter/binary_fuse.hpp"
+#include "bf/bloom_filter/count_min.hpp"
+#include "bf/bloom_filter/cuckoo.hpp"
+#include "bf/bloom_filter/numa.hpp"
+#include "bf/bloom_filter/paged.hpp"
+#include "bf/bloom_filter/quotient.hpp"
+#include "bf/bloom_filter/reloadable.hpp"
+#include "bf/bloom_filter/ribbon.hpp"
+#include "bf/bloom_filter/shared.hpp"
+#include "bf/bloom_filter/stable.hpp"
+#include "bf/storage.hpp"
+#include "bf/multi_probe.hpp"
 
 #endif
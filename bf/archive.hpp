@@ -0,0 +1,130 @@
+#ifndef BF_ARCHIVE_HPP
+#define BF_ARCHIVE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bf/bloom_filter/basic.hpp>
+#include <bf/storage.hpp>
+
+namespace bf {
+namespace detail {
+
+// An entry of the table of contents of an archive.
+struct archive_entry {
+  uint64_t offset;
+  uint64_t cells;
+  uint64_t k;
+  uint64_t seed;
+  uint64_t name_offset;
+  uint64_t name_size;
+  uint8_t scheme;
+  uint8_t family;
+  uint8_t reduction;
+  uint8_t partition;
+  uint8_t padding[12];
+};
+
+} // namespace detail
+
+/// Writes many basic Bloom filters, e.g., one per sample, into a single
+/// archive file. Each filter's bits start at a page boundary, and a table of
+/// contents at the end records their names, offsets and parameters, so that
+/// an ::archive can open any filter without reading the others.
+class archive_writer {
+public:
+  /// The alignment of the filter bits within the file.
+  static constexpr size_t alignment = 4096;
+
+  /// Creates an archive.
+  /// @param filename The file to write.
+  /// @throws std::runtime_error if the file cannot be created.
+  explicit archive_writer(std::string const& filename);
+
+  /// Finishes the archive unless ::close was called.
+  ~archive_writer();
+
+  /// Appends a filter.
+  /// @param name The name under which the filter can be found.
+  /// @param filter The filter.
+  /// @throws std::invalid_argument if the name is already taken.
+  /// @throws std::runtime_error if the file cannot be written.
+  void add(std::string const& name, basic_bloom_filter const& filter);
+
+  /// Writes the table of contents and closes the file.
+  /// @throws std::runtime_error if the file cannot be written.
+  void close();
+
+private:
+  std::string filename_;
+  std::ofstream out_;
+  std::vector<detail::archive_entry> entries_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, size_t> index_;
+};
+
+/// A read-only archive of basic Bloom filters written by ::archive_writer.
+/// Opening an archive maps the file and reads only its table of contents;
+/// the bits of a filter are paged in when it is used.
+class archive {
+public:
+  /// Opens an archive.
+  /// @param filename The file.
+  /// @throws std::runtime_error if the file cannot be mapped or is not a
+  ///         valid archive.
+  explicit archive(std::string const& filename);
+
+  /// Returns the number of filters.
+  size_t size() const;
+
+  /// Returns the name of a filter.
+  /// @param i The index of the filter, in the order of addition.
+  std::string const& name(size_t i) const;
+
+  /// Returns the index of a filter.
+  /// @param name The name of the filter.
+  /// @throws std::out_of_range if there is no filter with this name.
+  size_t index(std::string const& name) const;
+
+  /// Returns a filter whose bits are mapped from the file, without copying
+  /// them. Adding to the filter copies the pages it modifies; neither the
+  /// file nor other filters opened from it change. The mapping stays alive
+  /// as long as the filter.
+  /// @param i The index of the filter.
+  std::unique_ptr<basic_bloom_filter> open(size_t i) const;
+
+  /// Copies a filter into memory.
+  /// @param i The index of the filter.
+  /// @param allocator The allocator of the bits, or `nullptr` for the default.
+  std::unique_ptr<basic_bloom_filter>
+  load(size_t i, std::shared_ptr<storage_allocator> allocator = nullptr) const;
+
+  /// Copies several filters into memory in parallel.
+  /// @param indices The indices of the filters.
+  /// @param threads The number of threads.
+  /// @return The filters in the order of *indices*.
+  std::vector<std::unique_ptr<basic_bloom_filter>>
+  load(std::vector<size_t> const& indices, size_t threads) const;
+
+private:
+  detail::archive_entry const& at(size_t i) const;
+  bitvector view(size_t i) const;
+
+  std::string filename_;
+  // The descriptor of the file, from which filters are mapped.
+  std::shared_ptr<int> file_;
+  // The mapping of the whole file, for the table of contents.
+  std::shared_ptr<void> mapping_;
+  size_t size_ = 0;
+  detail::archive_entry const* entries_ = nullptr;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, size_t> index_;
+};
+
+} // namespace bf
+
+#endif
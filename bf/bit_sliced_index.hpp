@@ -0,0 +1,76 @@
+#ifndef BF_BIT_SLICED_INDEX_HPP
+#define BF_BIT_SLICED_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bf/bitvector.hpp>
+#include <bf/bloom_filter/basic.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A bit-sliced signature index over *N* basic Bloom filters which share
+/// their size and hasher, e.g., one filter per sample. The index stores the
+/// transposed bit matrix: row *i* holds bit *i* of every filter, so the *k*
+/// rows of an element are contiguous *N*-bit vectors, and a lookup ANDs them
+/// word by word to obtain the set of filters containing the element.
+class bit_sliced_index {
+public:
+  /// Builds an index from filters in memory.
+  /// @param filters The filters, which become samples `0..N-1`.
+  /// @throws std::invalid_argument if the filters differ in their number of
+  ///         cells, hasher configuration or reduction, or use partitioning.
+  explicit bit_sliced_index(
+    std::vector<basic_bloom_filter const*> const& filters);
+
+  /// Builds an index from filter files written by
+  /// basic_bloom_filter::save. The files are loaded one at a time, so only
+  /// the index and a single filter reside in memory.
+  /// @param filenames The files, which become samples `0..N-1`.
+  /// @throws std::invalid_argument if the filters are incompatible.
+  explicit bit_sliced_index(std::vector<std::string> const& filenames);
+
+  /// Retrieves the samples which may contain an element.
+  /// @tparam T The type of the element to query.
+  /// @param x An instance of type `T`.
+  /// @return A bit vector with bit *j* set iff filter *j* contains *x*.
+  template <typename T>
+  bitvector lookup(T const& x) const {
+    return lookup(wrap(x));
+  }
+
+  /// Retrieves the samples which may contain an element.
+  /// @param o A wrapped object.
+  /// @return A bit vector with bit *j* set iff filter *j* contains *o*.
+  bitvector lookup(object const& o) const;
+
+  /// Counts for each sample how many of the given elements it contains, e.g.,
+  /// the k-mers of one read.
+  /// @param objects The elements to query.
+  /// @return The number of hits per sample.
+  std::vector<size_t> count(std::vector<object> const& objects) const;
+
+  /// Returns the number of samples.
+  size_t samples() const;
+
+  /// Returns the number of cells per filter, i.e., the number of rows.
+  size_t cells() const;
+
+private:
+  void init(basic_bloom_filter const& first, size_t samples);
+  void insert(basic_bloom_filter const& filter, size_t sample);
+
+  hasher hasher_;
+  hasher_config config_;
+  reduction reduction_ = reduction::modulo;
+  size_t cells_ = 0;
+  size_t samples_ = 0;
+  size_t words_per_row_ = 0;
+  std::vector<uint64_t> rows_;
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef BF_BITVECTOR_HPP
+#define BF_BITVECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <bf/storage.hpp>
+
+namespace bf {
+
+/// A fixed-size sequence of bits stored in 64-bit blocks. Bit *i* lives in
+/// block `i / 64` at position `i % 64`, so on little-endian machines the
+/// in-memory layout matches the byte-wise layout of the file format. Bits
+/// past the end of the last block are always zero.
+///
+/// Besides plain access, the vector offers atomic variants of reading and
+/// setting bits, which may be used concurrently from several threads.
+///
+/// The blocks come from a ::storage_allocator, e.g., one backed by huge
+/// pages. Copies use the allocator of their source.
+class bitvector {
+public:
+  typedef uint64_t block_type;
+
+  static constexpr size_t bits_per_block = 64;
+
+  /// Constructs an empty bit vector.
+  bitvector() = default;
+
+  /// Constructs a bit vector with all bits cleared.
+  /// @param size The number of bits.
+  /// @param allocator The allocator of the blocks, or `nullptr` for the
+  ///                  ::default_allocator.
+  explicit bitvector(size_t size,
+                     std::shared_ptr<storage_allocator> allocator = nullptr);
+
+  /// Constructs a view of existing blocks, e.g., in shared memory, which
+  /// the vector neither clears nor frees. Copies of a view own their blocks.
+  /// @param blocks The blocks, `(size + 63) / 64` of them, with the bits past
+  ///               *size* cleared.
+  /// @param size The number of bits.
+  /// @param owner An object to keep alive as long as the view, e.g., the
+  ///              mapping of the blocks.
+  bitvector(block_type* blocks, size_t size,
+            std::shared_ptr<void> owner = nullptr);
+
+  bitvector(bitvector const& other);
+  bitvector(bitvector&& other);
+  bitvector& operator=(bitvector const& other);
+  bitvector& operator=(bitvector&& other);
+  ~bitvector();
+
+  /// Returns the allocator of the blocks, or `nullptr` for a
+  /// default-constructed vector or a view.
+  std::shared_ptr<storage_allocator> const& allocator() const;
+
+  /// Returns the number of bits.
+  size_t size() const;
+
+  /// Returns the number of blocks.
+  size_t blocks_count() const;
+
+  /// Returns a pointer to the first block.
+  block_type* blocks();
+
+  /// Returns a pointer to the first block.
+  block_type const* blocks() const;
+
+  /// Retrieves a bit.
+  /// @param i The bit index.
+  bool operator[](size_t i) const {
+    return (blocks_[i / bits_per_block] >> (i % bits_per_block)) & 1;
+  }
+
+  /// Sets a bit.
+  /// @param i The bit index.
+  void set(size_t i) {
+    blocks_[i / bits_per_block] |= block_type(1) << (i % bits_per_block);
+  }
+
+  /// Sets a bit and returns its previous value.
+  /// @param i The bit index.
+  bool test_and_set(size_t i) {
+    auto& b = blocks_[i / bits_per_block];
+    auto mask = block_type(1) << (i % bits_per_block);
+    auto old = b & mask;
+    b |= mask;
+    return old != 0;
+  }
+
+  /// Retrieves a bit with an atomic load.
+  /// @param i The bit index.
+  bool atomic_test(size_t i) const {
+    auto b = __atomic_load_n(&blocks_[i / bits_per_block], __ATOMIC_RELAXED);
+    return (b >> (i % bits_per_block)) & 1;
+  }
+
+  /// Atomically sets a bit and returns its previous value.
+  /// @param i The bit index.
+  bool atomic_test_and_set(size_t i) {
+    auto mask = block_type(1) << (i % bits_per_block);
+    auto old = __atomic_fetch_or(&blocks_[i / bits_per_block], mask,
+                                 __ATOMIC_RELAXED);
+    return (old & mask) != 0;
+  }
+
+  /// Clears all bits.
+  void clear();
+
+  /// Swaps two bit vectors.
+  void swap(bitvector& other);
+
+  friend bool operator==(bitvector const& x, bitvector const& y);
+  friend bool operator!=(bitvector const& x, bitvector const& y);
+
+private:
+  void release();
+
+  size_t size_ = 0;
+  size_t blocks_count_ = 0;
+  block_type* blocks_ = nullptr;
+  std::shared_ptr<storage_allocator> allocator_;
+  std::shared_ptr<void> owner_;
+};
+
+} // namespace bf
+
+#endif
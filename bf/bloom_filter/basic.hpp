@@ -1,74 +1,343 @@
 #ifndef BF_BLOOM_FILTER_BASIC_HPP
 #define BF_BLOOM_FILTER_BASIC_HPP
 
+#include <bf/bitvector.hpp>
 #include <bf/bloom_filter.hpp>
 #include <bf/hash.hpp>
+#include <atomic>
+#include <future>
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <random>
 
 namespace bf {
 /// The basic Bloom filter.
 ///
-/// @note This Bloom filter does not use partitioning because it results in
-/// slightly worse performance because partitioned Bloom filters tend to have
-/// more 1s than non-partitioned filters.
+/// @note This Bloom filter does not use partitioning by default because it
+/// results in slightly worse performance because partitioned Bloom filters
+/// tend to have more 1s than non-partitioned filters. When partitioning,
+/// hash function *i* maps into the *i*-th contiguous partition, so that the
+/// partitions can be filled in parallel without synchronization; see
+/// make_partitioned_filter.
 class basic_bloom_filter : public bloom_filter {
    public:
     static size_t m(double fp, size_t capacity);
 
     static size_t k(size_t cells, size_t capacity);
 
-    basic_bloom_filter(size_t numberOfHashFunctions, size_t cells, bool partition = false);
+    /// Returns the number of cells a filter allocates when asked for *cells*.
+    /// @param k The number of hash functions.
+    /// @param cells The requested number of cells.
+    /// @param partition Whether the filter is partitioned.
+    /// @param r How digests are mapped to cells.
+    static size_t rounded_cells(size_t k, size_t cells, bool partition, reduction r);
+
+    /// Constructs an empty basic Bloom filter.
+    /// @param numberOfHashFunctions The number of hash functions *k*.
+    /// @param cells The number of cells. With partitioning, it is rounded up
+    /// to a multiple of *k*; with reduction::mask, the number of cells (per
+    /// partition) is rounded up to a power of two.
+    /// @param partition Whether each hash function maps into its own
+    /// partition of `cells / k` cells.
+    /// @param r How digests are mapped to cells.
+    basic_bloom_filter(size_t numberOfHashFunctions, size_t cells, bool partition = false,
+                       reduction r = reduction::fastrange);
+
+    /// Constructs an empty basic Bloom filter with a given hasher
+    /// configuration, e.g., double hashing, a custom seed or a single 128-bit
+    /// hash per element. The configuration is saved along with the filter.
+    /// @param config The hasher configuration.
+    /// @param cells The number of cells.
+    /// @param partition Whether each hash function maps into its own
+    /// partition.
+    /// @param r How digests are mapped to cells.
+    /// @param allocator The allocator of the bits, e.g., a
+    /// huge_page_allocator for large filters, or `nullptr` for the default.
+    basic_bloom_filter(hasher_config const& config, size_t cells, bool partition = false,
+                       reduction r = reduction::fastrange,
+                       std::shared_ptr<storage_allocator> allocator = nullptr);
 
     basic_bloom_filter(std::string filename,
                        bool& hasKzandcanonicalvalues,
                        unsigned long long& K,
                        unsigned long long& z,
                        bool& canonical,
-                       bool partition = false);
+                       bool partition = false,
+                       std::shared_ptr<storage_allocator> allocator = nullptr);
+
+    /// Copies a filter into storage from another allocator, e.g., to place
+    /// a replica on a specific NUMA node.
+    /// @param other The filter to copy.
+    /// @param allocator The allocator of the copy's bits.
+    basic_bloom_filter(basic_bloom_filter const& other,
+                       std::shared_ptr<storage_allocator> allocator);
+
+    /// Constructs a basic Bloom filter over existing bits, e.g., a view of
+    /// a shared-memory segment. The number of cells is taken as is.
+    /// @param config The hasher configuration.
+    /// @param bits The bits.
+    /// @param partition Whether each hash function maps into its own
+    /// partition.
+    /// @param r How digests are mapped to cells.
+    /// @throws std::invalid_argument if the number of cells does not fit
+    /// *partition* and *r*.
+    basic_bloom_filter(hasher_config const& config, bitvector bits, bool partition,
+                       reduction r);
+
+    /// Constructs a basic Bloom filter over a buffer written by
+    /// ::serialize_to, or holding a file written by ::save, without copying
+    /// the bits. Adding to the filter modifies the buffer.
+    /// @param buffer The buffer, aligned to 8 bytes, which must outlive the
+    /// filter.
+    /// @param size The size of the buffer in bytes.
+    /// @param K Receives the value passed to ::serialize_to.
+    /// @param z Receives the value passed to ::serialize_to.
+    /// @param canonical Receives the value passed to ::serialize_to.
+    /// @throws std::invalid_argument if the buffer is not aligned.
+    /// @throws std::runtime_error if the buffer does not hold a filter.
+    basic_bloom_filter(uint8_t* buffer, size_t size, unsigned long long& K,
+                       unsigned long long& z, bool& canonical);
 
     basic_bloom_filter(basic_bloom_filter&&);
 
+    ~basic_bloom_filter();
+
     using bloom_filter::add;
     using bloom_filter::lookup;
 
     virtual void add(object const& o) override;
     virtual size_t lookup(object const& o) const override;
 
+    /// Adds several elements. The elements are hashed in batches, and the
+    /// bits of a batch are prefetched before they are set.
+    /// @param objects The elements to add.
+    /// @param n The number of elements.
+    void add(object const* objects, size_t n);
+
+    /// Adds several elements using several threads. The elements are hashed
+    /// in parallel; then, for a partitioned filter, each thread sets the bits
+    /// of its own partitions, which keeps its writes within a small region of
+    /// memory. Since there are *k* partitions, at most *k* threads set bits
+    /// in this case. Otherwise the threads split the elements and set bits
+    /// atomically. Bits of partitions are set atomically only in concurrent
+    /// mode, so without it the call must not overlap other modifications.
+    /// @param objects The elements to add.
+    /// @param n The number of elements.
+    /// @param threads The number of threads.
+    void add(object const* objects, size_t n, size_t threads);
+
+    /// Looks up several elements, hashing and prefetching them in batches.
+    /// @param objects The elements to look up.
+    /// @param n The number of elements.
+    /// @param results Receives the result of looking up element *i* at
+    /// index *i*.
+    void lookup(object const* objects, size_t n, size_t* results) const;
+
+    /// Looks up an element by its digests, e.g., when several filters with
+    /// the same hasher configuration are probed with one hash computation.
+    /// @param digests The result of applying `hasher_function()` to the
+    /// element.
+    /// @return 1 if all *k* bits are set and 0 otherwise.
+    size_t lookup_digests(std::vector<digest> const& digests) const;
+
+    /// Adds an element unless it is already present, hashing it only once.
+    /// @tparam T The type of the element to insert.
+    /// @param x An instance of type `T`.
+    /// @return `true` iff at least one bit was newly set, i.e., iff a
+    /// lookup before the insertion would have returned 0.
+    template <typename T>
+    bool add_if_absent(T const& x) {
+        return add_if_absent(wrap(x));
+    }
+
+    /// Adds an element unless it is already present, hashing it only once.
+    /// In concurrent mode, when several threads insert the same element at
+    /// the same time, exactly one of them observes it as new.
+    /// @param o A wrapped object.
+    /// @return `true` iff at least one bit was newly set.
+    bool add_if_absent(object const& o);
+
+    /// Enables or disables concurrent mode. In concurrent mode, `add`,
+    /// `add_if_absent` and `lookup` may be called from several threads at
+    /// once; bits are then read and set with atomic operations.
+    /// @pre No other thread accesses the filter during the call.
+    void concurrent(bool enable);
+
+    /// Returns whether the filter is in concurrent mode.
+    bool concurrent() const;
+
     /// Swaps two basic Bloom filters.
     /// @param other The other basic Bloom filter.
     void swap(basic_bloom_filter& other);
 
     /// Returns the underlying storage of the Bloom filter.
-    std::vector<bool> const& storage() const;
+    bitvector const& storage() const;
 
     /// Returns the hasher of the Bloom filter.
     hasher const& hasher_function() const;
 
     size_t getNumberOfHashFunctions() const;
 
-    /// Saves the Bloom filter in a file named filename.
+    /// Returns the configuration from which the hasher was created.
+    hasher_config configuration() const;
+
+    /// Returns whether each hash function maps into its own partition.
+    bool partitioned() const;
+
+    /// Returns how digests are mapped to cells.
+    reduction reduction_mode() const;
+
+    /// Saves the Bloom filter in a file named filename, along with the
+    /// parameters needed to reproduce its bit positions.
     void save(const std::string& filename, const unsigned long long& K,
               const unsigned long long& z, const bool& canonical);
 
+    /// Saves the Bloom filter like ::save, but on a background thread, while
+    /// elements continue to be added. The file holds exactly the elements
+    /// added before the call; in concurrent mode, elements added by other
+    /// threads during the call may be partially included. Until the bits are
+    /// captured, each add first copies the region it modifies into the
+    /// snapshot, and the background thread copies the remaining regions.
+    /// @param filename The file to write.
+    /// @return A future which becomes ready once the file is written, or holds
+    /// a std::runtime_error if it cannot be written.
+    /// @pre The filter is neither destroyed, moved nor swapped until the
+    /// future is ready.
+    std::future<void> save_async(std::string const& filename, unsigned long long K,
+                                 unsigned long long z, bool canonical);
+
+    /// Enables or disables tracking which regions of the bits change, which
+    /// ::save_delta requires. Tracking starts with no region changed.
+    /// @pre No other thread accesses the filter during the call.
+    void track_changes(bool enable);
+
+    /// Returns whether changes are tracked.
+    bool tracking_changes() const;
+
+    /// Saves the regions of the bits changed since the last checkpoint, i.e.,
+    /// the last call of ::save, ::save_async, ::save_delta or
+    /// ::track_changes. Replaying the deltas in order with ::apply_delta on
+    /// the filter of the preceding checkpoint restores this filter. In
+    /// concurrent mode, elements may be added meanwhile; they are part of
+    /// this delta or the next.
+    /// @param filename The file to write.
+    /// @throws std::logic_error if changes are not tracked.
+    /// @throws std::runtime_error if the file cannot be written.
+    void save_delta(std::string const& filename);
+
+    /// Applies a delta written by ::save_delta.
+    /// @param filename The file to read.
+    /// @throws std::runtime_error if the file cannot be read or stems from a
+    /// filter with a different number of cells or hash functions.
+    /// @pre No other thread accesses the filter during the call.
+    void apply_delta(std::string const& filename);
+
+    /// Returns the number of bytes ::serialize_to writes.
+    size_t serialized_size() const;
+
+    /// Writes the Bloom filter to a buffer in the format of ::save.
+    /// @param buffer The buffer.
+    /// @param size The size of the buffer in bytes.
+    /// @param K Stored along with the filter, as in ::save.
+    /// @param z Stored along with the filter, as in ::save.
+    /// @param canonical Stored along with the filter, as in ::save.
+    /// @return The number of bytes written, i.e., `serialized_size()`.
+    /// @throws std::length_error if the buffer is too small.
+    size_t serialize_to(uint8_t* buffer, size_t size, unsigned long long K = 0,
+                        unsigned long long z = 0, bool canonical = false) const;
+
     /**
-     * @brief Saves the filter to a file. Assume the file is open. Does not close it (but flush it). Do not wite any UUID (just write the size of the filter and the filter itself).
+     * @brief Saves the filter to a file. Assume the file is open. Does not close it (but flush it). Writes the same format as save, with K = z = 0 and canonical = false,
+     * so that the filter loads back with its parameters.
+     * @note Format change: earlier versions wrote only the number of cells and the bits, without a UUID or header, which readers of that format must now skip.
+     * Such headerless files still load, with reduction::modulo.
      * @param fout the file to save the filter to.
      * @return (void)
      */
     void simpleSave(std::ofstream& fout);
 
    private:
+    /// Keeps its bits on disk, but shares the header and cell positions.
+    friend class paged_bloom_filter;
+
+    /// The number of locks which serialize concurrent `add_if_absent` calls
+    /// for elements with the same first digest.
+    static constexpr size_t lock_stripes = 1024;
+
+    /// The number of elements hashed at once by the batch operations.
+    static constexpr size_t batch_size = 256;
+
+    /// The largest number of hash functions whose probes a lookup prefetches
+    /// before testing them.
+    static constexpr size_t max_prefetch = 16;
+
+    /// The number of elements the parallel build hashes before setting bits.
+    static constexpr size_t parallel_chunk = 1 << 20;
+
+    /// The number of blocks an add copies into a pending snapshot at once.
+    static constexpr size_t snapshot_segment = 1 << 12;
+
+    /// The number of blocks per region whose changes are tracked.
+    static constexpr size_t delta_region = 64;
+
+    struct snapshot_state;
+
+    size_t position(size_t i, digest d) const;
+    void update_range();
     void writeUUID(std::ofstream& fout);
+    void writeHeader(std::ostream& out, unsigned long long K, unsigned long long z,
+                     bool canonical) const;
+    /// Reads the version 4 header following the UUID, up to the bits.
+    void readHeader(std::istream& in, unsigned long long& K, unsigned long long& z,
+                    bool& canonical, std::string const& source);
+    /// Takes the bits of a filter whose header was read.
+    void adopt(bitvector bits, std::string const& source);
+    /// Copies the snapshot segment holding cell *p* unless it was copied.
+    void preserve(size_t p);
+    void preserveSegment(size_t segment);
+    /// Marks the region holding cell *p* as changed, after its bit was set.
+    void markDirty(size_t p);
+    /// Unmarks all regions and returns the ones that were marked.
+    std::vector<size_t> takeDirty();
+    batch_hasher batch_;
     hasher hasher_;
-    std::vector<bool> bits_;
+    bitvector bits_;
     bool partition_;
+    reduction reduction_ = reduction::fastrange;
+    hash_scheme scheme_ = hash_scheme::independent;
+    hash_family family_ = hash_family::h3;
+    size_t seed_ = 0;
+    /// The number of cells a digest is reduced to, i.e., the partition size
+    /// when partitioning and the number of cells otherwise.
+    size_t range_ = 0;
+    bool concurrent_ = false;
+    std::unique_ptr<std::atomic<bool>[]> locks_;
+    /// Whether a snapshot is capturing the bits, in which case adds call
+    /// `preserve` before setting a bit.
+    std::atomic<bool> snapshotting_{false};
+    std::unique_ptr<snapshot_state> snapshot_;
+    bool tracking_ = false;
+    /// One bit per region of `delta_region` blocks.
+    bitvector dirty_;
     std::string uuid_2_0_0 = "93d4c313-eed5-434e-bddd-34bd2ba23a12";
     std::string uuid_3_0_0 = "c625b08b-0a6c-4fda-82b6-2e213f4c04f1";
+    std::string uuid_4_0_0 = "6b1f0c2e-94d7-4a3b-8e15-c0a97d3e5f28";
+    std::string uuid_delta_1_0_0 = "d3a8e1c4-5b7f-4e29-a06d-8c1f2b9e7d43";
     size_t numberOfHashFunctions_ = 1;
 };
 
 basic_bloom_filter make_filter(double fp, size_t capacity);
 basic_bloom_filter* make_filter_ptr(double fp, size_t capacity);
+
+/// Creates a partitioned Bloom filter with power-of-two partitions, which
+/// maps digests to cells with a mask.
+/// @param fp The desired false-positive probability.
+/// @param capacity The expected number of elements.
+/// @param config The hasher configuration; its *k* is replaced by the optimal
+/// number of hash functions.
+basic_bloom_filter* make_partitioned_filter_ptr(double fp, size_t capacity,
+                                                hasher_config config = hasher_config());
 }  // namespace bf
 
 #endif
@@ -0,0 +1,88 @@
+#ifndef BF_BLOOM_FILTER_BINARY_FUSE_HPP
+#define BF_BLOOM_FILTER_BINARY_FUSE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bf/bloom_filter.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A static 3-wise binary fuse filter (Graf and Lemire). The filter is built
+/// once from a complete set of keys and afterwards only answers lookups. It
+/// stores one fingerprint per slot in about `1.13 n` slots for large *n*, and
+/// a lookup XORs the fingerprints of three slots, i.e., performs three memory
+/// accesses. The false-positive rate is about `2^-b` for *b*-bit
+/// fingerprints.
+///
+/// @tparam Fingerprint The fingerprint type, `uint8_t` or `uint16_t`.
+template <typename Fingerprint>
+class binary_fuse_filter : public bloom_filter {
+public:
+  /// Builds a filter from a set of keys. Duplicate keys are allowed.
+  /// @param keys The keys to store.
+  /// @param threads The number of threads used for hashing and sorting the
+  ///                keys.
+  /// @param seed The seed of the hash function applied to the keys.
+  /// @throws std::runtime_error if no valid filter was found, which in
+  ///         practice does not happen.
+  binary_fuse_filter(std::vector<object> const& keys, size_t threads = 1,
+                     size_t seed = 0);
+
+  /// Builds a filter from a set of integer keys, e.g., encoded k-mers. The
+  /// keys are hashed like `wrap(key)`.
+  binary_fuse_filter(std::vector<uint64_t> const& keys, size_t threads = 1,
+                     size_t seed = 0);
+
+  /// Loads a filter from a file written by ::save.
+  /// @throws std::runtime_error if the file cannot be read or does not
+  ///         contain a binary fuse filter with matching fingerprints.
+  binary_fuse_filter(std::string const& filename, unsigned long long& K,
+                     unsigned long long& z, bool& canonical);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// Not supported: a binary fuse filter is static.
+  /// @throws std::logic_error
+  virtual void add(object const& o) override;
+
+  /// Tests whether an element may be in the filter.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Returns the number of fingerprint slots.
+  size_t slots() const;
+
+  /// Returns the fingerprints.
+  std::vector<Fingerprint> const& storage() const;
+
+  /// Saves the filter in a file named filename.
+  void save(std::string const& filename, unsigned long long K,
+            unsigned long long z, bool canonical) const;
+
+private:
+  void build(std::vector<uint64_t> digests, size_t threads);
+  bool construct(std::vector<uint64_t>& hashes);
+  void positions(uint64_t hash, size_t* h) const;
+  size_t lookup_hash(uint64_t hash) const;
+
+  hash_function hash_;
+  size_t seed_;
+  uint64_t fuse_seed_ = 0;
+  size_t segment_length_ = 0;
+  size_t segment_count_length_ = 0;
+  std::vector<Fingerprint> fingerprints_;
+  std::string uuid_1_0_0 = "a0f5e1c7-3b8d-4e29-8c64-9d2b7f1e5a30";
+};
+
+typedef binary_fuse_filter<uint8_t> binary_fuse8_filter;
+typedef binary_fuse_filter<uint16_t> binary_fuse16_filter;
+
+extern template class binary_fuse_filter<uint8_t>;
+extern template class binary_fuse_filter<uint16_t>;
+
+} // namespace bf
+
+#endif
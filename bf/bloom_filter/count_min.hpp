@@ -0,0 +1,88 @@
+#ifndef BF_BLOOM_FILTER_COUNT_MIN_HPP
+#define BF_BLOOM_FILTER_COUNT_MIN_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <bf/bloom_filter.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A count-min sketch. Each of the *d* digests of an element selects one
+/// counter in its own row of *w* counters. Adding an element increments the
+/// selected counters and a lookup returns their minimum, which never
+/// underestimates the true frequency.
+///
+/// The rows are stored one after another in a single contiguous array, so
+/// each probe touches exactly one counter per row and merging or clearing
+/// streams linearly through memory.
+class count_min_sketch : public bloom_filter {
+public:
+  typedef uint32_t counter_type;
+
+  /// Computes the number of counters per row for a given error factor.
+  /// @param epsilon The estimate exceeds the true count by at most
+  ///                `epsilon * N`, where *N* is the number of additions.
+  /// @return The row width `ceil(e / epsilon)`.
+  static size_t w(double epsilon);
+
+  /// Computes the number of rows for a given failure probability.
+  /// @param delta The probability that the error bound does not hold.
+  /// @return The depth `ceil(ln(1 / delta))`.
+  static size_t d(double delta);
+
+  /// Constructs a count-min sketch.
+  /// @param depth The number of rows, i.e., the number of hash functions.
+  /// @param width The number of counters per row.
+  /// @param conservative If `true`, an addition only increments the counters
+  ///                     which equal the current estimate. This never makes
+  ///                     an estimate worse and greatly reduces overestimation
+  ///                     for skewed streams, but the sketch then only
+  ///                     supports additions of one.
+  count_min_sketch(size_t depth, size_t width, bool conservative = false);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// Increments the counters of an element. Counters saturate at their
+  /// maximum value.
+  virtual void add(object const& o) override;
+
+  /// Estimates the frequency of an element.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Resets all counters to zero.
+  void clear();
+
+  /// Adds the counters of another sketch element-wise.
+  /// @param other A sketch with the same depth and width.
+  /// @throws std::invalid_argument if the dimensions differ.
+  void merge(count_min_sketch const& other);
+
+  /// Returns the number of rows.
+  size_t depth() const;
+
+  /// Returns the number of counters per row.
+  size_t width() const;
+
+  /// Returns whether the sketch uses conservative update.
+  bool conservative() const;
+
+  /// Returns the counters, stored row after row.
+  std::vector<counter_type> const& storage() const;
+
+  /// Returns the hasher of the sketch.
+  hasher const& hasher_function() const;
+
+private:
+  hasher hasher_;
+  size_t depth_;
+  size_t width_;
+  bool conservative_;
+  std::vector<counter_type> cells_;
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef BF_BLOOM_FILTER_CUCKOO_HPP
+#define BF_BLOOM_FILTER_CUCKOO_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bf/bloom_filter.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A cuckoo filter (Fan et al.) with buckets of four fingerprints. Each
+/// element has two candidate buckets; the second one is derived from the
+/// first one and the fingerprint alone, so fingerprints can be relocated and
+/// deleted without access to the original element.
+///
+/// A bucket occupies 32 or 64 bits inside a single 64-bit block, so a lookup
+/// reads at most two cache lines and compares all four fingerprints of a
+/// bucket at once. With 16-bit fingerprints the false-positive rate is about
+/// 8 / 2^16 at a space cost of 16 bits per slot.
+class cuckoo_filter : public bloom_filter {
+public:
+  static constexpr size_t bucket_size = 4;
+
+  /// Constructs an empty cuckoo filter.
+  /// @param capacity The number of elements the filter should hold. The
+  ///                 number of buckets is rounded up to a power of two and
+  ///                 chosen for a load factor of at most 95%.
+  /// @param fingerprint_bits The number of bits per fingerprint, 8 or 16.
+  /// @param seed The seed of the hash function.
+  cuckoo_filter(size_t capacity, size_t fingerprint_bits = 16,
+                size_t seed = 0);
+
+  /// Loads a cuckoo filter from a file written by ::save.
+  /// @throws std::runtime_error if the file cannot be read or does not
+  ///         contain a cuckoo filter.
+  cuckoo_filter(std::string const& filename, unsigned long long& K,
+                unsigned long long& z, bool& canonical);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// Adds an element.
+  /// @throws std::length_error if the filter is full.
+  virtual void add(object const& o) override;
+
+  /// Tests whether an element may be in the filter.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Adds an element.
+  /// @return `false` iff the filter is full and the element was not added.
+  bool insert(object const& o);
+
+  /// Adds a sequence of elements. All elements are hashed upfront and their
+  /// buckets prefetched before insertion.
+  /// @param objects The elements to add.
+  /// @param n The number of elements.
+  /// @return The number of elements added before the filter became full.
+  size_t insert(object const* objects, size_t n);
+
+  /// Removes an element.
+  /// @tparam T The type of the element to remove.
+  /// @param x An instance of type `T`.
+  template <typename T>
+  bool remove(T const& x) {
+    return remove(wrap(x));
+  }
+
+  /// Removes an element. Removing an element which was never added may
+  /// remove another element with the same fingerprint.
+  /// @return `true` iff a matching fingerprint was removed.
+  bool remove(object const& o);
+
+  /// Removes all elements.
+  void clear();
+
+  /// Returns the number of stored fingerprints.
+  size_t size() const;
+
+  /// Returns the number of slots.
+  size_t slots() const;
+
+  /// Returns the number of bits per fingerprint.
+  size_t fingerprint_bits() const;
+
+  /// Saves the filter in a file named filename.
+  void save(std::string const& filename, unsigned long long K,
+            unsigned long long z, bool canonical) const;
+
+private:
+  static constexpr size_t max_kicks = 500;
+
+  struct position {
+    size_t bucket;
+    uint64_t fingerprint;
+  };
+
+  void init(size_t buckets, size_t fingerprint_bits);
+  position locate(object const& o) const;
+  size_t alternate(size_t bucket, uint64_t fingerprint) const;
+  uint64_t bucket(size_t i) const;
+  uint64_t slot(size_t i, size_t j) const;
+  void slot(size_t i, size_t j, uint64_t fingerprint);
+  bool contains(size_t i, uint64_t fingerprint) const;
+  bool try_insert(size_t i, uint64_t fingerprint);
+  bool try_remove(size_t i, uint64_t fingerprint);
+  bool insert(position p);
+  uint64_t next();
+
+  hash_function hash_;
+  size_t seed_;
+  size_t fingerprint_bits_;
+  uint64_t fingerprint_mask_;
+  uint64_t bucket_mask_;
+  uint64_t lanes_low_;
+  uint64_t lanes_high_;
+  size_t buckets_;
+  size_t count_ = 0;
+  bool victim_used_ = false;
+  size_t victim_bucket_ = 0;
+  uint64_t victim_fingerprint_ = 0;
+  uint64_t state_ = 0x9e3779b97f4a7c15ULL;
+  std::vector<uint64_t> blocks_;
+  std::string uuid_1_0_0 = "5f2e6b0c-8d3a-4c71-9b0e-3a7d41c2e8f5";
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef BF_BLOOM_FILTER_NUMA_HPP
+#define BF_BLOOM_FILTER_NUMA_HPP
+
+#include <memory>
+#include <vector>
+
+#include <bf/bloom_filter/basic.hpp>
+
+namespace bf {
+
+/// A read-only basic Bloom filter for multi-socket machines. By default it
+/// keeps one replica of the bits per NUMA node, and each lookup probes the
+/// replica of the node the calling thread runs on, so that probes never
+/// cross the interconnect. Filters too large to replicate can instead be
+/// stored once with their pages interleaved over all nodes, which spreads
+/// the remote accesses evenly.
+class numa_bloom_filter : public bloom_filter {
+public:
+  /// How the bits are placed on the NUMA nodes.
+  enum class placement {
+    /// One replica per node.
+    replicate,
+    /// A single copy with pages interleaved over all nodes.
+    interleave
+  };
+
+  /// Copies a filter onto the NUMA nodes.
+  /// @param filter The filter to copy.
+  /// @param p How to place the copies.
+  numa_bloom_filter(basic_bloom_filter const& filter,
+                    placement p = placement::replicate);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// @throws std::logic_error since the filter is read-only.
+  virtual void add(object const& o) override;
+
+  /// Looks up an element in the replica of the calling thread's node.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Returns the number of copies of the bits.
+  size_t replicas() const;
+
+  /// Returns the copy probed by threads on a node.
+  /// @param node The NUMA node.
+  basic_bloom_filter const& replica(size_t node) const;
+
+private:
+  std::vector<std::unique_ptr<basic_bloom_filter>> copies_;
+  // The index into copies_ for each node number.
+  std::vector<size_t> routes_;
+};
+
+} // namespace bf
+
+#endif
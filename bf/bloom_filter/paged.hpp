@@ -0,0 +1,142 @@
+#ifndef BF_BLOOM_FILTER_PAGED_HPP
+#define BF_BLOOM_FILTER_PAGED_HPP
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <bf/bloom_filter/basic.hpp>
+
+namespace bf {
+
+/// A basic Bloom filter whose bits stay in a file, for filters larger than
+/// memory. The file has the format of basic_bloom_filter::save; its bits are
+/// read in fixed-size pages, of which the least recently used are evicted
+/// once the cached pages exceed a memory budget. Modified pages are written
+/// back on eviction and by ::flush.
+///
+/// Since each probe may miss the cache, elements should be added and looked
+/// up in batches: the batch operations sort the probes by position, so that
+/// every page is loaded at most once per batch.
+///
+/// The filter is not thread-safe, not even for lookups, which update the
+/// cache.
+class paged_bloom_filter : public bloom_filter {
+public:
+  /// The default page size.
+  static constexpr size_t default_page_size = size_t(1) << 20;
+
+  /// Opens a filter saved by basic_bloom_filter::save in the current
+  /// version.
+  /// @param filename The file.
+  /// @param budget The memory for cached pages in bytes. At least one page
+  ///               is cached.
+  /// @param page_size The page size in bytes, a multiple of 8.
+  /// @param writable Whether elements may be added.
+  /// @throws std::invalid_argument if *page_size* is invalid.
+  /// @throws std::runtime_error if the file cannot be opened or does not
+  ///         hold a filter.
+  paged_bloom_filter(std::string const& filename, size_t budget,
+                     size_t page_size = default_page_size,
+                     bool writable = true);
+
+  /// Creates an empty filter in a new file without allocating its bits,
+  /// which are zero until written.
+  /// @param filename The file, which is overwritten.
+  /// @param config The hasher configuration.
+  /// @param cells The number of cells, rounded as by basic_bloom_filter.
+  /// @param budget The memory for cached pages in bytes.
+  /// @param page_size The page size in bytes, a multiple of 8.
+  /// @param partition Whether each hash function maps into its own
+  ///                  partition.
+  /// @param r How digests are mapped to cells.
+  /// @throws std::runtime_error if the file cannot be created.
+  paged_bloom_filter(std::string const& filename, hasher_config const& config,
+                     size_t cells, size_t budget,
+                     size_t page_size = default_page_size,
+                     bool partition = false,
+                     reduction r = reduction::fastrange);
+
+  /// Writes back modified pages and closes the file.
+  ~paged_bloom_filter();
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// @throws std::logic_error if the filter is not writable.
+  virtual void add(object const& o) override;
+  virtual size_t lookup(object const& o) const override;
+
+  /// Adds several elements, loading each page at most once per batch.
+  /// @param objects The elements to add.
+  /// @param n The number of elements.
+  /// @throws std::logic_error if the filter is not writable.
+  void add(object const* objects, size_t n);
+
+  /// Looks up several elements, loading each page at most once per batch.
+  /// @param objects The elements to look up.
+  /// @param n The number of elements.
+  /// @param results Receives the result of element *i* at index *i*.
+  void lookup(object const* objects, size_t n, size_t* results) const;
+
+  /// Writes all modified pages to the file.
+  /// @throws std::runtime_error if a page cannot be written.
+  void flush();
+
+  /// Returns the configuration from which the hasher was created.
+  hasher_config configuration() const;
+
+  /// Returns the number of cells.
+  size_t cells() const;
+
+  /// Returns the page size in bytes.
+  size_t page_size() const;
+
+  /// Returns the largest number of pages in memory.
+  size_t page_capacity() const;
+
+  /// Returns the number of pages in memory.
+  size_t cached_pages() const;
+
+  /// Returns the number of pages read from the file so far.
+  size_t page_loads() const;
+
+private:
+  /// The number of elements hashed and sorted at once by the batch
+  /// operations.
+  static constexpr size_t batch_size = size_t(1) << 16;
+
+  struct page {
+    std::vector<bitvector::block_type> blocks;
+    bool dirty = false;
+    std::list<size_t>::iterator position;
+  };
+
+  void open(std::string const& filename, bool writable);
+  page& fetch(size_t index) const;
+  void write(size_t index, page const& p) const;
+  bool test(size_t cell) const;
+  void set(size_t cell);
+  // Computes the cells of a batch, sorted, paired with their element.
+  void probes(object const* objects, size_t n,
+              std::vector<std::pair<size_t, size_t>>& out) const;
+
+  // Holds the parameters and computes cell positions; its bits are a view
+  // without storage.
+  basic_bloom_filter shell_;
+  int fd_ = -1;
+  bool writable_;
+  uint64_t offset_ = 0;
+  size_t page_size_;
+  size_t capacity_;
+  mutable size_t loads_ = 0;
+  mutable std::list<size_t> lru_;
+  mutable std::unordered_map<size_t, page> pages_;
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef BF_BLOOM_FILTER_QUOTIENT_HPP
+#define BF_BLOOM_FILTER_QUOTIENT_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <bf/bloom_filter.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A counting rank-and-select quotient filter (Pandey et al.). Each element
+/// hashes to a *p*-bit fingerprint which is split into a *q*-bit quotient,
+/// the home slot, and an *r*-bit remainder, which is stored. The remainders
+/// of one quotient form a sorted run; runs are kept in quotient order and
+/// shifted right as needed. Two bit vectors mark occupied quotients and run
+/// ends, and per-block offsets let rank and select start nearby, so a lookup
+/// scans a few consecutive slots.
+///
+/// Slots are grouped into blocks of 64 that store their metadata next to
+/// their packed remainders. Since the full fingerprint can be recovered from
+/// a slot, the filter can double its size and merge with another filter
+/// without access to the original elements. Repeated insertions of an
+/// element are stored as repeated remainders, so a lookup returns a count.
+class quotient_filter : public bloom_filter {
+public:
+  /// Constructs an empty quotient filter.
+  /// @param quotient_bits The log2 of the number of slots.
+  /// @param remainder_bits The number of bits per slot, between 1 and 56.
+  ///                       Each doubling moves one bit from the remainder to
+  ///                       the quotient.
+  /// @param seed The seed of the hash function.
+  quotient_filter(size_t quotient_bits, size_t remainder_bits,
+                  size_t seed = 0);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// Adds an element, doubling the filter first if it is too full.
+  /// @throws std::length_error if the filter has no remainder bits left to
+  ///         grow.
+  virtual void add(object const& o) override;
+
+  /// Counts how often an element was added, up to false positives.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Removes one occurrence of an element.
+  /// @tparam T The type of the element to remove.
+  /// @param x An instance of type `T`.
+  template <typename T>
+  bool remove(T const& x) {
+    return remove(wrap(x));
+  }
+
+  /// Removes one occurrence of an element.
+  /// @return `true` iff a matching remainder was removed.
+  bool remove(object const& o);
+
+  /// Doubles the number of slots in a single linear pass. The remainders are
+  /// copied into a new array, so that the old and the new array, about three
+  /// times the old size, are held at the peak.
+  /// @throws std::length_error if the remainder has only one bit.
+  void resize();
+
+  /// Adds all elements of another filter in a single linear pass over both
+  /// filters. As with ::resize, the result is built in a new array.
+  /// @param other A filter with the same fingerprint size and seed.
+  /// @throws std::invalid_argument if the filters are incompatible.
+  void merge(quotient_filter const& other);
+
+  /// Removes all elements.
+  void clear();
+
+  /// Returns the number of stored remainders.
+  size_t size() const;
+
+  /// Returns the number of home slots.
+  size_t slots() const;
+
+  /// Returns the number of quotient bits.
+  size_t quotient_bits() const;
+
+  /// Returns the number of remainder bits.
+  size_t remainder_bits() const;
+
+private:
+  static constexpr size_t slots_per_block = 64;
+  static constexpr size_t header_words = 3;
+  static constexpr double max_load = 0.95;
+
+  // Enumerates the stored fingerprints in sorted order.
+  class cursor;
+
+  void init(size_t quotient_bits, size_t remainder_bits);
+  uint64_t fingerprint(object const& o) const;
+  bool insert(uint64_t quotient, uint64_t remainder);
+  void append(uint64_t quotient, uint64_t remainder, int64_t& last_end,
+              uint64_t& last_quotient);
+  void rebuild_offsets(size_t first, size_t last);
+  // Takes the dimensions and slots of a filter built by ::resize or ::merge.
+  void take(quotient_filter& other);
+
+  int64_t run_end(uint64_t quotient) const;
+  int64_t select_run_end(size_t from, size_t rank) const;
+  size_t find_unused(size_t from) const;
+
+  uint64_t* block(size_t slot);
+  uint64_t const* block(size_t slot) const;
+  bool occupied(size_t slot) const;
+  void occupied(size_t slot, bool value);
+  bool is_run_end(size_t slot) const;
+  void is_run_end(size_t slot, bool value);
+  uint64_t remainder(size_t slot) const;
+  void remainder(size_t slot, uint64_t value);
+
+  hash_function hash_;
+  size_t seed_;
+  size_t quotient_bits_;
+  size_t remainder_bits_;
+  uint64_t remainder_mask_;
+  size_t total_slots_;
+  size_t count_ = 0;
+  std::vector<uint64_t> blocks_;
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef BF_BLOOM_FILTER_RELOADABLE_HPP
+#define BF_BLOOM_FILTER_RELOADABLE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <bf/bloom_filter/basic.hpp>
+
+namespace bf {
+
+/// Holds a read-only basic Bloom filter that can be replaced while other
+/// threads query it, e.g., when a service periodically reloads a rebuilt
+/// filter from disk. Readers never block: a lookup announces itself in an
+/// epoch counter and then probes whichever filter is current. Publishing a
+/// new filter swaps a pointer and then waits, on the publishing thread only,
+/// until all lookups that may still see the old filter have finished,
+/// before freeing it.
+class reloadable_bloom_filter : public bloom_filter {
+public:
+  /// Constructs a holder.
+  /// @param filter The initial filter.
+  /// @pre `filter != nullptr`
+  explicit reloadable_bloom_filter(std::unique_ptr<basic_bloom_filter> filter);
+
+  /// Constructs a holder of a filter loaded from a file.
+  /// @param filename The file, as written by basic_bloom_filter::save.
+  /// @throws std::runtime_error if the file cannot be loaded.
+  explicit reloadable_bloom_filter(std::string const& filename);
+
+  /// @pre No lookups or reloads are in progress.
+  ~reloadable_bloom_filter();
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// @throws std::logic_error since the filter is read-only.
+  virtual void add(object const& o) override;
+
+  virtual size_t lookup(object const& o) const override;
+
+  /// Looks up several elements in the same filter.
+  /// @param objects The elements to look up.
+  /// @param n The number of elements.
+  /// @param results Receives the result of element *i* at index *i*.
+  void lookup(object const* objects, size_t n, size_t* results) const;
+
+  /// Invokes a function on the current filter, which stays alive until the
+  /// function returns.
+  /// @param f A function taking a `basic_bloom_filter const&`.
+  /// @return The result of *f*.
+  template <typename F>
+  auto read(F f) const -> decltype(f(std::declval<basic_bloom_filter const&>())) {
+    guard g(*this);
+    return f(*g.filter);
+  }
+
+  /// Replaces the current filter. Lookups that start after the call see the
+  /// new filter; the call returns once the old filter is freed.
+  /// @param filter The new filter.
+  /// @pre `filter != nullptr`
+  void publish(std::unique_ptr<basic_bloom_filter> filter);
+
+  /// Loads a filter from a file on a background thread and publishes it.
+  /// @param filename The file, as written by basic_bloom_filter::save.
+  /// @return A future which becomes ready once the old filter is freed, or
+  ///         holds the std::runtime_error of a failed load, in which case the
+  ///         current filter is kept.
+  std::future<void> reload(std::string filename);
+
+  /// Returns the number of filters published after the initial one.
+  uint64_t generation() const;
+
+private:
+  /// The number of counters per epoch over which readers spread, so that
+  /// they rarely contend on a cache line.
+  static constexpr size_t stripes = 64;
+
+  struct alignas(64) stripe {
+    std::atomic<uint64_t> readers{0};
+  };
+
+  // Pins the current filter for the lifetime of a lookup.
+  struct guard {
+    explicit guard(reloadable_bloom_filter const& holder);
+    ~guard();
+    std::atomic<uint64_t>* counter;
+    basic_bloom_filter const* filter;
+  };
+
+  static size_t stripe_index();
+
+  std::atomic<basic_bloom_filter*> current_;
+  std::atomic<uint64_t> epoch_{0};
+  mutable stripe counters_[2][stripes];
+  // Serializes publishers.
+  std::mutex publish_;
+};
+
+} // namespace bf
+
+#endif
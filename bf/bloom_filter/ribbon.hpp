@@ -0,0 +1,95 @@
+#ifndef BF_BLOOM_FILTER_RIBBON_HPP
+#define BF_BLOOM_FILTER_RIBBON_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <bf/bloom_filter.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A static standard Ribbon filter (Dillinger and Walzer) with 64-bit
+/// coefficient bands. Each key maps to a start row and a random 64-bit band
+/// of coefficients; the filter stores a solution matrix with *r* bits per row
+/// such that, for every key, the XOR of the rows selected by its band equals
+/// the key's *r*-bit fingerprint. This needs only a few percent more than the
+/// information-theoretic minimum of *r* bits per key for a false-positive
+/// rate of `2^-r`.
+///
+/// The solution is stored interleaved: each block of 64 rows holds *r*
+/// consecutive words, one per result bit. A lookup therefore reads two
+/// adjacent blocks, i.e., one contiguous range of `2 r` words.
+///
+/// Keys are distributed over independent shards by their hash, so that
+/// shards can be solved concurrently.
+class ribbon_filter : public bloom_filter {
+public:
+  /// Builds a filter from a set of keys. Duplicate keys are allowed.
+  /// @param keys The keys to store.
+  /// @param result_bits The number of bits per row, between 1 and 16.
+  /// @param threads The number of threads, which also bounds the number of
+  ///                shards.
+  /// @param seed The seed of the hash function applied to the keys.
+  ribbon_filter(std::vector<object> const& keys, size_t result_bits = 8,
+                size_t threads = 1, size_t seed = 0);
+
+  /// Builds a filter from a set of integer keys, e.g., encoded k-mers. The
+  /// keys are hashed like `wrap(key)`.
+  ribbon_filter(std::vector<uint64_t> const& keys, size_t result_bits = 8,
+                size_t threads = 1, size_t seed = 0);
+
+  /// Loads a filter from a file written by ::save.
+  /// @throws std::runtime_error if the file cannot be read or does not
+  ///         contain a Ribbon filter.
+  ribbon_filter(std::string const& filename, unsigned long long& K,
+                unsigned long long& z, bool& canonical);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// Not supported: a Ribbon filter is static.
+  /// @throws std::logic_error
+  virtual void add(object const& o) override;
+
+  /// Tests whether an element may be in the filter.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Returns the number of solution rows.
+  size_t rows() const;
+
+  /// Returns the number of bits per row.
+  size_t result_bits() const;
+
+  /// Returns the solution words.
+  std::vector<uint64_t> const& storage() const;
+
+  /// Saves the filter in a file named filename.
+  void save(std::string const& filename, unsigned long long K,
+            unsigned long long z, bool canonical) const;
+
+private:
+  struct band {
+    size_t shard;
+    uint64_t start_hash;
+    uint64_t coefficients;
+    uint64_t result;
+  };
+
+  band make_band(digest d) const;
+  void build(std::vector<digest> const& digests, size_t threads);
+  bool solve(std::vector<band>& bands, size_t blocks,
+             std::vector<uint64_t>& solution) const;
+
+  hash_function hash_;
+  size_t seed_;
+  size_t result_bits_;
+  std::vector<size_t> shard_offsets_;
+  std::vector<uint64_t> solution_;
+  std::string uuid_1_0_0 = "3c9b7e52-1f04-4a8d-b6e3-0d5a28f7c914";
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef BF_BLOOM_FILTER_SHARED_HPP
+#define BF_BLOOM_FILTER_SHARED_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <bf/bloom_filter/basic.hpp>
+
+namespace bf {
+
+/// A basic Bloom filter in a named POSIX shared-memory segment, so that
+/// several processes, e.g., query workers, probe one copy of the bits.
+/// One process creates the segment; others attach to it by name, either
+/// read-only or writable. A versioned header at the start of the segment
+/// records the filter parameters, which attachers validate and adopt.
+/// Since the bits may change under a reader at any time, the filter is in
+/// concurrent mode and reads and sets bits atomically.
+class shared_bloom_filter : public bloom_filter {
+public:
+  /// The version of the segment layout.
+  static constexpr uint32_t version = 1;
+
+  /// Creates a segment holding an empty filter.
+  /// @param name The name of the segment, e.g., `/bf-index`.
+  /// @param config The hasher configuration.
+  /// @param cells The number of cells, rounded as by basic_bloom_filter.
+  /// @param partition Whether each hash function maps into its own
+  ///                  partition.
+  /// @param r How digests are mapped to cells.
+  /// @throws std::system_error if the segment exists or cannot be created.
+  shared_bloom_filter(std::string name, hasher_config const& config,
+                      size_t cells, bool partition = false,
+                      reduction r = reduction::fastrange);
+
+  /// Attaches to an existing segment.
+  /// @param name The name of the segment.
+  /// @param writable Whether the filter may be modified.
+  /// @throws std::system_error if the segment cannot be opened or mapped.
+  /// @throws std::runtime_error if the header is incomplete, of another
+  ///         version, or does not match the size of the segment.
+  explicit shared_bloom_filter(std::string name, bool writable = false);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// @throws std::logic_error if the filter is attached read-only.
+  virtual void add(object const& o) override;
+
+  virtual size_t lookup(object const& o) const override;
+
+  /// Returns the filter over the segment.
+  basic_bloom_filter const& filter() const;
+
+  /// Returns the name of the segment.
+  std::string const& name() const;
+
+  /// Returns whether the filter may be modified.
+  bool writable() const;
+
+  /// Removes the name of a segment. Processes that are attached keep their
+  /// mapping until they detach.
+  /// @param name The name of the segment.
+  /// @return `true` iff the segment existed.
+  static bool remove(std::string const& name);
+
+private:
+  std::string name_;
+  bool writable_;
+  std::unique_ptr<basic_bloom_filter> filter_;
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef BF_BLOOM_FILTER_STABLE_HPP
+#define BF_BLOOM_FILTER_STABLE_HPP
+
+#include <cstdint>
+
+#include <bf/bloom_filter.hpp>
+#include <bf/counter_vector.hpp>
+#include <bf/hash.hpp>
+
+namespace bf {
+
+/// A stable Bloom filter (Deng and Rafiei). Before each insertion, *P* cells
+/// are decremented by one, which continuously evicts stale information so
+/// that the fraction of zero cells converges to a constant. The filter thus
+/// deduplicates an unbounded stream in fixed memory, at the cost of a bounded
+/// rate of false negatives for elements that were inserted long ago.
+///
+/// The evicted cells form a run of *P* consecutive counters starting at a
+/// pseudo-random position, so an insertion costs one PRNG step and touches
+/// only a few cache lines regardless of the filter size.
+class stable_bloom_filter : public bloom_filter {
+public:
+  /// Computes the number of cells to evict per insertion so that the false
+  /// positive rate converges to a given value.
+  /// @param fp The desired stable false positive rate.
+  /// @param k The number of hash functions.
+  /// @param cells The number of cells.
+  /// @param width The number of bits per cell.
+  /// @return The number of cells to evict, at least 1.
+  static size_t p(double fp, size_t k, size_t cells, size_t width);
+
+  /// Constructs a stable Bloom filter.
+  /// @param k The number of hash functions.
+  /// @param cells The number of cells.
+  /// @param width The number of bits per cell.
+  /// @param evict The number of cells to decrement per insertion.
+  /// @param seed The seed of the eviction PRNG.
+  stable_bloom_filter(size_t k, size_t cells, size_t width, size_t evict,
+                      uint64_t seed = 0);
+
+  using bloom_filter::add;
+  using bloom_filter::lookup;
+
+  /// Evicts *P* cells and then sets the cells of an element to the maximum.
+  virtual void add(object const& o) override;
+
+  /// Tests whether all cells of an element are non-zero.
+  virtual size_t lookup(object const& o) const override;
+
+  /// Resets all cells to zero.
+  void clear();
+
+  /// Returns the underlying cells.
+  counter_vector const& storage() const;
+
+  /// Returns the number of cells decremented per insertion.
+  size_t evict() const;
+
+  /// Returns the hasher of the Bloom filter.
+  hasher const& hasher_function() const;
+
+private:
+  uint64_t next();
+
+  hasher hasher_;
+  counter_vector cells_;
+  size_t evict_;
+  uint64_t state_;
+};
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef BF_COUNTER_VECTOR_HPP
+#define BF_COUNTER_VECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bf {
+
+/// A vector of fixed-width unsigned counters packed into 64-bit blocks.
+/// Counters may straddle two blocks, so any width between 1 and 32 bits
+/// wastes no space.
+class counter_vector {
+public:
+  typedef uint64_t block_type;
+
+  /// Constructs a counter vector with all counters set to zero.
+  /// @param cells The number of counters.
+  /// @param width The number of bits per counter.
+  /// @pre `width > 0 && width <= 32`
+  counter_vector(size_t cells, size_t width);
+
+  /// Returns the number of counters.
+  size_t size() const;
+
+  /// Returns the number of bits per counter.
+  size_t width() const;
+
+  /// Returns the largest value a counter can hold.
+  size_t max() const;
+
+  /// Retrieves the value of a counter.
+  /// @param cell The counter index.
+  size_t count(size_t cell) const;
+
+  /// Sets a counter to a given value.
+  /// @param cell The counter index.
+  /// @param value The new value.
+  /// @pre `value <= max()`
+  void set(size_t cell, size_t value);
+
+  /// Increments a counter unless it is saturated.
+  /// @return `true` iff the counter changed.
+  bool increment(size_t cell);
+
+  /// Decrements a counter unless it is zero.
+  /// @return `true` iff the counter changed.
+  bool decrement(size_t cell);
+
+  /// Sets all counters to zero.
+  void clear();
+
+  /// Returns the underlying blocks.
+  std::vector<block_type> const& blocks() const;
+
+private:
+  static constexpr size_t bits_per_block = 64;
+
+  size_t cells_;
+  size_t width_;
+  block_type mask_;
+  // One extra block so that reading a straddling counter never goes out of
+  // bounds.
+  std::vector<block_type> blocks_;
+};
+
+} // namespace bf
+
+#endif
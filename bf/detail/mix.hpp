@@ -0,0 +1,27 @@
+#ifndef BF_DETAIL_MIX_HPP
+#define BF_DETAIL_MIX_HPP
+
+#include <cstdint>
+
+namespace bf {
+namespace detail {
+
+/// The 64-bit finalizer of MurmurHash3, a bijective mixing function.
+inline uint64_t murmur64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/// Returns the upper 64 bits of the 128-bit product of two integers.
+inline uint64_t mulhi(uint64_t a, uint64_t b) {
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+}
+
+} // namespace detail
+} // namespace bf
+
+#endif
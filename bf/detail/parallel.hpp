@@ -0,0 +1,57 @@
+#ifndef BF_DETAIL_PARALLEL_HPP
+#define BF_DETAIL_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace bf {
+namespace detail {
+
+/// Splits the range `[0, n)` into *threads* contiguous chunks and invokes
+/// `f(begin, end)` for each chunk on its own thread.
+template <typename F>
+void parallel_for(size_t n, size_t threads, F f) {
+  threads = std::max(size_t(1), std::min(threads, n));
+  if (threads == 1) {
+    f(size_t(0), n);
+    return;
+  }
+  std::vector<std::thread> workers;
+  auto chunk = (n + threads - 1) / threads;
+  for (size_t begin = 0; begin < n; begin += chunk)
+    workers.emplace_back(f, begin, std::min(n, begin + chunk));
+  for (auto& t : workers)
+    t.join();
+}
+
+/// Sorts a vector by sorting *threads* chunks concurrently and merging them
+/// pairwise.
+template <typename T>
+void parallel_sort(std::vector<T>& xs, size_t threads) {
+  auto n = xs.size();
+  threads = std::max(size_t(1), std::min(threads, n / 1024 + 1));
+  auto chunk = (n + threads - 1) / threads;
+  parallel_for(n, threads, [&](size_t begin, size_t end) {
+    std::sort(xs.begin() + begin, xs.begin() + end);
+  });
+  for (auto width = chunk; width < n; width *= 2) {
+    std::vector<size_t> starts;
+    for (size_t begin = 0; begin + width < n; begin += 2 * width)
+      starts.push_back(begin);
+    parallel_for(starts.size(), starts.size(), [&](size_t first, size_t last) {
+      for (auto i = first; i < last; ++i) {
+        auto begin = xs.begin() + starts[i];
+        auto mid = begin + width;
+        auto end = xs.begin() + std::min(n, starts[i] + 2 * width);
+        std::inplace_merge(begin, mid, end);
+      }
+    });
+  }
+}
+
+} // namespace detail
+} // namespace bf
+
+#endif
@@ -28,14 +28,14 @@ public:
         bits[bit] = (bits[bit] << 16) | (prng() & 0xFFFF);
     }
 
+    // Each entry extends the entry without its lowest set bit.
     for (size_t byte = 0; byte < N; ++byte)
-      for (size_t val = 0; val < byte_range; ++val)
-      {
-        bytes_[byte][val] = 0;
-        for (size_t bit = 0; bit < bits_per_byte; ++bit)
-          if (val & (1 << bit))
-            bytes_[byte][val] ^= bits[byte * bits_per_byte + bit];
-      }
+    {
+      bytes_[byte][0] = 0;
+      for (size_t val = 1; val < byte_range; ++val)
+        bytes_[byte][val] = bytes_[byte][val & (val - 1)]
+          ^ bits[byte * bits_per_byte + __builtin_ctz(val)];
+    }
   }
 
   T operator()(void const* data, size_t size, size_t offset = 0) const
@@ -62,6 +62,13 @@ public:
     return result;
   }
 
+  /// Returns the table for one byte position of the input.
+  /// @param byte The byte position, less than *N*.
+  T const* table(size_t byte) const
+  {
+    return bytes_[byte];
+  }
+
 private:
   T bytes_[N][byte_range];
 };
@@ -1,7 +1,12 @@
 #ifndef BF_HASH_POLICY_HPP
 #define BF_HASH_POLICY_HPP
 
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <vector>
+#include <bf/detail/mix.hpp>
 #include <bf/h3.hpp>
 #include <bf/object.hpp>
 
@@ -16,19 +21,102 @@ typedef std::function<digest(object const&)> hash_function;
 /// A function that hashes an object *k* times.
 typedef std::function<std::vector<digest>(object const&)> hasher;
 
+/// The ways to map a digest to a cell index in `[0, n)`. The numeric values
+/// are part of the file format.
+enum class reduction : uint8_t {
+  /// `d % n`, which costs a 64-bit division.
+  modulo = 0,
+  /// The upper 64 bits of the 128-bit product `d * n` (Lemire's fast range
+  /// reduction), which costs a multiplication and uses the high bits of *d*.
+  fastrange = 1,
+  /// `d & (n - 1)`, which requires *n* to be a power of two.
+  mask = 2
+};
+
+/// Maps a digest to a cell index.
+/// @param d The digest.
+/// @param n The number of cells.
+/// @param r The reduction to apply.
+/// @return An index in `[0, n)`.
+inline size_t reduce(digest d, size_t n, reduction r) {
+  switch (r) {
+    case reduction::fastrange:
+      return detail::mulhi(d, n);
+    case reduction::mask:
+      return d & (n - 1);
+    default:
+      return d % n;
+  }
+}
+
+/// Computes the 64-bit wyhash (final version 4) of a byte sequence, a
+/// streaming hash which processes long inputs at several GB/s.
+/// @param data The bytes to hash.
+/// @param size The number of bytes.
+/// @param seed The seed.
+/// @return The hash.
+uint64_t wyhash(void const* data, size_t size, uint64_t seed = 0);
+
+/// The default hash function: H3 tabulation hashing for objects of up to
+/// ::max_obj_size bytes, and ::wyhash with the same seed for larger objects.
+/// The H3 tables are generated once per seed and shared by all instances in
+/// the process, so constructing or copying the function is cheap.
 class default_hash_function
 {
 public:
   constexpr static size_t max_obj_size = 36;
 
+  /// The H3 tables for all byte positions.
+  typedef h3<size_t, max_obj_size> table_type;
+
+  /// The number of objects the batch operator hashes per iteration.
+  constexpr static size_t batch_lanes = 8;
+
   default_hash_function(size_t seed);
 
   size_t operator()(object const& o) const;
 
+  /// Hashes several objects. Runs of ::batch_lanes objects of the same size
+  /// are hashed byte by byte across all lanes, so that their independent
+  /// table lookups overlap instead of forming one dependency chain per object.
+  /// @param objects The objects to hash.
+  /// @param n The number of objects.
+  /// @param out Receives the digest of object *i* at `out[i * stride]`.
+  /// @param stride The distance between two digests in *out*.
+  void operator()(object const* objects, size_t n, digest* out,
+                  size_t stride = 1) const;
+
+  /// Retrieves the tables for a seed from the process-wide cache, generating
+  /// them on first use. The function is thread-safe.
+  /// @param seed The seed of the tables.
+  /// @return The tables, which live until the end of the process.
+  static std::shared_ptr<table_type const> tables(size_t seed);
+
+private:
+  std::shared_ptr<table_type const> h3_;
+  size_t seed_;
+};
+
+/// A hash function which applies ::wyhash to objects of any size.
+class wyhash_function
+{
+public:
+  wyhash_function(size_t seed);
+
+  size_t operator()(object const& o) const;
+
 private:
-  h3<size_t, max_obj_size> h3_;
+  size_t seed_;
 };
 
+/// Computes the 128-bit MurmurHash3 (x64 variant) of a byte sequence.
+/// @param data The bytes to hash.
+/// @param size The number of bytes.
+/// @param seed The seed.
+/// @return The two 64-bit halves of the hash.
+std::array<uint64_t, 2> hash128(void const* data, size_t size,
+                                uint64_t seed = 0);
+
 /// A hasher which hashes an object *k* times.
 class default_hasher
 {
@@ -56,6 +144,116 @@ private:
   hash_function h2_;
 };
 
+/// A hasher which computes a single 128-bit hash and derives *k* digests from
+/// its halves *a* and *b* by enhanced double hashing (Dillinger and
+/// Manolios): digest *i* is `a + i * b + (i^3 - i) / 6`, which avoids the
+/// repeated probe patterns of plain double hashing. It needs no tables, so
+/// the hasher occupies no cache besides the key.
+class enhanced_double_hasher
+{
+public:
+  enhanced_double_hasher(size_t k, size_t seed);
+
+  std::vector<digest> operator()(object const& o) const;
+
+private:
+  size_t k_;
+  size_t seed_;
+};
+
+/// The ways a hasher derives *k* digests. The numeric values are part of the
+/// file format.
+enum class hash_scheme : uint8_t {
+  /// *k* independent hash functions, see ::default_hasher.
+  independent = 0,
+  /// Two hash functions combined linearly, see ::double_hasher.
+  double_hashing = 1,
+  /// One 128-bit hash, see ::enhanced_double_hasher.
+  enhanced_double = 2
+};
+
+/// The hash functions underlying the ::independent and ::double_hashing
+/// schemes. The numeric values are part of the file format.
+enum class hash_family : uint8_t {
+  /// ::default_hash_function, i.e., H3 for small objects.
+  h3 = 0,
+  /// ::wyhash_function.
+  wyhash = 1
+};
+
+/// The parameters from which a hasher can be reconstructed.
+struct hasher_config
+{
+  hasher_config(size_t k = 1, hash_scheme scheme = hash_scheme::independent,
+                hash_family family = hash_family::h3, size_t seed = 0)
+    : k(k), scheme(scheme), family(family), seed(seed)
+  {
+  }
+
+  /// The number of digests.
+  size_t k;
+
+  /// How the digests are derived.
+  hash_scheme scheme;
+
+  /// The hash functions to derive the digests from. The ::enhanced_double
+  /// scheme always uses ::hash128.
+  hash_family family;
+
+  /// The seed. Independent and double hashing draw the seeds of their hash
+  /// functions from a PRNG seeded with it, as ::make_hasher does.
+  size_t seed;
+};
+
+inline bool operator==(hasher_config const& x, hasher_config const& y) {
+  return x.k == y.k && x.scheme == y.scheme && x.family == y.family
+         && x.seed == y.seed;
+}
+
+inline bool operator!=(hasher_config const& x, hasher_config const& y) {
+  return !(x == y);
+}
+
+/// A hasher reconstructed from a ::hasher_config, which can also hash many
+/// objects at once. Copies share the hash function tables.
+class batch_hasher
+{
+public:
+  /// Constructs an empty hasher which must be assigned before use.
+  batch_hasher() = default;
+
+  /// Constructs the hasher described by a configuration.
+  /// @param config The configuration.
+  /// @pre `config.k > 0`
+  explicit batch_hasher(hasher_config const& config);
+
+  /// Computes the *k* digests of an object.
+  std::vector<digest> operator()(object const& o) const;
+
+  /// Computes the *k* digests of several objects.
+  /// @param objects The objects to hash.
+  /// @param n The number of objects.
+  /// @param out Receives digest *j* of object *i* at `out[i * k + j]`.
+  void operator()(object const* objects, size_t n, digest* out) const;
+
+  /// Returns the configuration of the hasher.
+  hasher_config const& config() const;
+
+private:
+  void base(size_t i, object const* objects, size_t n, digest* out,
+            size_t stride) const;
+
+  hasher_config config_;
+  std::vector<std::shared_ptr<default_hash_function const>> h3_;
+  std::vector<size_t> seeds_;
+};
+
+/// Creates a hasher from its configuration.
+/// @param config The configuration.
+/// @return A ::batch_hasher producing `config.k` digests.
+/// @pre `config.k > 0`
+hasher make_hasher(hasher_config const& config);
+
 /// Creates a default or double hasher with the default hash function, using
 /// seeds from a linear congruential PRNG.
 ///
@@ -0,0 +1,36 @@
+#ifndef BF_MULTI_PROBE_HPP
+#define BF_MULTI_PROBE_HPP
+
+#include <vector>
+
+#include <bf/bitvector.hpp>
+#include <bf/bloom_filter/basic.hpp>
+#include <bf/wrap.hpp>
+
+namespace bf {
+
+/// Looks up an element in several basic Bloom filters, hashing it only once.
+/// The filters may differ in size, since each reduces the shared digests
+/// with its own number of cells, but must use the same hasher configuration.
+/// @param o A wrapped object.
+/// @param filters The filters to probe.
+/// @return A bit vector with bit *j* set iff filter *j* contains *o*.
+/// @throws std::invalid_argument if the filters differ in their hasher
+///         configuration.
+bitvector probe(object const& o,
+                std::vector<basic_bloom_filter const*> const& filters);
+
+/// Looks up an element in several basic Bloom filters, hashing it only once.
+/// @tparam T The type of the element to query.
+/// @param x An instance of type `T`.
+/// @param filters The filters to probe.
+/// @return A bit vector with bit *j* set iff filter *j* contains *x*.
+template <typename T>
+bitvector probe(T const& x,
+                std::vector<basic_bloom_filter const*> const& filters) {
+  return probe(wrap(x), filters);
+}
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef BF_STORAGE_HPP
+#define BF_STORAGE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace bf {
+
+/// Provides the memory behind a ::bitvector. Implementations must return
+/// zeroed memory aligned to at least 16 bytes.
+class storage_allocator {
+public:
+  virtual ~storage_allocator() = default;
+
+  /// Allocates zeroed memory.
+  /// @param bytes The number of bytes.
+  /// @return The memory.
+  /// @throws std::bad_alloc if the memory cannot be provided.
+  virtual void* allocate(size_t bytes) = 0;
+
+  /// Releases memory obtained from ::allocate.
+  /// @param p The memory.
+  /// @param bytes The number of bytes passed to ::allocate.
+  virtual void deallocate(void* p, size_t bytes) = 0;
+};
+
+/// Allocates from the heap. This is the default allocator.
+class heap_allocator : public storage_allocator {
+public:
+  void* allocate(size_t bytes) override;
+  void deallocate(void* p, size_t bytes) override;
+};
+
+/// Allocates large blocks of memory on 2 MB huge pages, which cuts the TLB
+/// misses of random probes into large filters. It first asks for explicit
+/// huge pages (`MAP_HUGETLB`) and otherwise maps regular pages and advises
+/// the kernel to back them with transparent huge pages. Requests smaller
+/// than one huge page are served from the heap.
+class huge_page_allocator : public storage_allocator {
+public:
+  static constexpr size_t huge_page_size = size_t(2) << 20;
+
+  void* allocate(size_t bytes) override;
+  void deallocate(void* p, size_t bytes) override;
+};
+
+/// Allocates consecutive regions of a caller-provided buffer, e.g., memory
+/// the caller has pinned or placed on a specific device. Deallocation does
+/// not reclaim space. The allocator is not thread-safe.
+class arena_allocator : public storage_allocator {
+public:
+  /// Constructs an arena over a buffer.
+  /// @param buffer The buffer, which must outlive all storage allocated
+  ///               from it.
+  /// @param size The size of the buffer in bytes.
+  arena_allocator(void* buffer, size_t size);
+
+  /// Allocates and zeroes the next 64-byte aligned region of the buffer.
+  /// @throws std::bad_alloc if the buffer is exhausted.
+  void* allocate(size_t bytes) override;
+
+  void deallocate(void* p, size_t bytes) override;
+
+  /// Returns the number of bytes still available, ignoring alignment.
+  size_t available() const;
+
+private:
+  char* buffer_;
+  size_t size_;
+  size_t used_ = 0;
+};
+
+/// Allocates memory whose pages are placed on given NUMA nodes, using the
+/// `mbind` system call before the pages are first touched. Placement is
+/// best-effort: on kernels without NUMA support, and on systems other than
+/// Linux, the memory is allocated as usual.
+class numa_allocator : public storage_allocator {
+public:
+  /// Constructs an allocator for a set of nodes.
+  /// @param nodes The node numbers.
+  /// @param interleave If `true`, pages are spread round-robin over the
+  ///                   nodes; otherwise they are preferably placed on the
+  ///                   first node.
+  explicit numa_allocator(std::vector<size_t> nodes, bool interleave = false);
+
+  /// @throws std::bad_alloc if the memory cannot be mapped.
+  /// @throws std::system_error if the kernel rejects the nodes.
+  void* allocate(size_t bytes) override;
+  void deallocate(void* p, size_t bytes) override;
+
+private:
+  std::vector<size_t> nodes_;
+  bool interleave_;
+};
+
+/// Returns the online NUMA nodes, or node 0 if the system does not expose
+/// them or is not Linux.
+std::vector<size_t> numa_nodes();
+
+/// Returns the NUMA node of the CPU the calling thread runs on. The node is
+/// cached per thread and refreshed every few hundred calls, which tracks
+/// migrations without a system call per invocation. Outside Linux it is 0.
+size_t current_numa_node();
+
+/// Returns the process-wide ::heap_allocator.
+std::shared_ptr<storage_allocator> const& default_allocator();
+
+} // namespace bf
+
+#endif
@@ -0,0 +1,256 @@
+#include <bf/archive.hpp>
+
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bf/detail/parallel.hpp>
+
+namespace bf {
+
+constexpr size_t archive_writer::alignment;
+
+namespace {
+
+// The header at the start of an archive. The table of contents and the
+// names follow the last filter.
+struct archive_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size;
+  uint64_t count;
+  uint64_t toc_offset;
+  uint64_t names_offset;
+  uint64_t names_size;
+};
+
+constexpr char archive_magic[8] = {'l', 'i', 'b', 'b', 'f', 'a', 'r', 'c'};
+constexpr uint32_t archive_version = 1;
+
+size_t payload_bytes(uint64_t cells) {
+  auto bits = bitvector::bits_per_block;
+  return (cells + bits - 1) / bits * sizeof(bitvector::block_type);
+}
+
+} // namespace
+
+archive_writer::archive_writer(std::string const& filename)
+    : filename_(filename),
+      out_(filename, std::ios::out | std::ios::binary | std::ios::trunc) {
+  if (!out_)
+    throw std::runtime_error("cannot create archive " + filename);
+  // The header is rewritten by close, once the offsets are known.
+  archive_header header = {};
+  out_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+}
+
+archive_writer::~archive_writer() {
+  if (out_.is_open()) {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+}
+
+void archive_writer::add(std::string const& name,
+                         basic_bloom_filter const& filter) {
+  if (!index_.emplace(name, entries_.size()).second)
+    throw std::invalid_argument("duplicate filter " + name + " in archive");
+  uint64_t offset = out_.tellp();
+  offset = (offset + alignment - 1) / alignment * alignment;
+  out_.seekp(offset);
+  auto& bits = filter.storage();
+  out_.write(reinterpret_cast<char const*>(bits.blocks()),
+             bits.blocks_count() * sizeof(bitvector::block_type));
+  if (!out_)
+    throw std::runtime_error("cannot write archive " + filename_);
+  auto config = filter.configuration();
+  detail::archive_entry e = {};
+  e.offset = offset;
+  e.cells = bits.size();
+  e.k = config.k;
+  e.seed = config.seed;
+  e.scheme = static_cast<uint8_t>(config.scheme);
+  e.family = static_cast<uint8_t>(config.family);
+  e.reduction = static_cast<uint8_t>(filter.reduction_mode());
+  e.partition = filter.partitioned();
+  entries_.push_back(e);
+  names_.push_back(name);
+}
+
+void archive_writer::close() {
+  // Seeking past the end leaves a hole; extend the file to cover the last
+  // payload.
+  out_.seekp(0, std::ios::end);
+  archive_header header = {};
+  std::memcpy(header.magic, archive_magic, sizeof(archive_magic));
+  header.version = archive_version;
+  header.entry_size = sizeof(detail::archive_entry);
+  header.count = entries_.size();
+  header.toc_offset = out_.tellp();
+  uint64_t name_offset = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    entries_[i].name_offset = name_offset;
+    entries_[i].name_size = names_[i].size();
+    name_offset += names_[i].size();
+  }
+  out_.write(reinterpret_cast<char const*>(entries_.data()),
+             entries_.size() * sizeof(detail::archive_entry));
+  header.names_offset = out_.tellp();
+  header.names_size = name_offset;
+  for (auto& name : names_)
+    out_.write(name.data(), name.size());
+  out_.seekp(0);
+  out_.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  out_.close();
+  if (!out_)
+    throw std::runtime_error("cannot write archive " + filename_);
+}
+
+archive::archive(std::string const& filename) : filename_(filename) {
+  auto fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("cannot open archive " + filename);
+  struct stat st;
+  auto ok = fstat(fd, &st) == 0;
+  auto file_size = ok ? static_cast<size_t>(st.st_size) : 0;
+  if (file_size < sizeof(archive_header)) {
+    ::close(fd);
+    throw std::runtime_error("no archive header in " + filename);
+  }
+  file_.reset(new int(fd), [](int* f) {
+    ::close(*f);
+    delete f;
+  });
+  auto p = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    throw std::runtime_error("cannot map archive " + filename);
+  mapping_.reset(p, [file_size](void* q) { munmap(q, file_size); });
+  auto base = static_cast<char const*>(p);
+  archive_header header;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, archive_magic, sizeof(archive_magic)) != 0)
+    throw std::runtime_error("no archive header in " + filename);
+  if (header.version != archive_version
+      || header.entry_size != sizeof(detail::archive_entry))
+    throw std::runtime_error("unsupported archive version "
+                             + std::to_string(header.version) + " in "
+                             + filename);
+  auto toc_size = header.count * sizeof(detail::archive_entry);
+  if (header.toc_offset % alignof(detail::archive_entry) != 0
+      || header.toc_offset > file_size
+      || header.count > (file_size - header.toc_offset)
+                          / sizeof(detail::archive_entry)
+      || header.names_offset < header.toc_offset + toc_size
+      || header.names_offset > file_size
+      || header.names_size > file_size - header.names_offset)
+    throw std::runtime_error("corrupt table of contents in " + filename);
+  size_ = header.count;
+  entries_ = reinterpret_cast<detail::archive_entry const*>(
+    base + header.toc_offset);
+  auto names = base + header.names_offset;
+  names_.reserve(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    auto& e = entries_[i];
+    if (e.offset % archive_writer::alignment != 0
+        || e.offset > header.toc_offset
+        || payload_bytes(e.cells) > header.toc_offset - e.offset
+        || e.k == 0
+        || e.scheme > static_cast<uint8_t>(hash_scheme::enhanced_double)
+        || e.family > static_cast<uint8_t>(hash_family::wyhash)
+        || e.reduction > static_cast<uint8_t>(reduction::mask)
+        || e.name_offset > header.names_size
+        || e.name_size > header.names_size - e.name_offset)
+      throw std::runtime_error("corrupt entry " + std::to_string(i) + " in "
+                               + filename);
+    names_.emplace_back(names + e.name_offset, e.name_size);
+    index_.emplace(names_.back(), i);
+  }
+}
+
+size_t archive::size() const {
+  return size_;
+}
+
+std::string const& archive::name(size_t i) const {
+  at(i);
+  return names_[i];
+}
+
+size_t archive::index(std::string const& name) const {
+  auto i = index_.find(name);
+  if (i == index_.end())
+    throw std::out_of_range("no filter " + name + " in " + filename_);
+  return i->second;
+}
+
+std::unique_ptr<basic_bloom_filter> archive::open(size_t i) const {
+  auto& e = at(i);
+  hasher_config config(e.k, static_cast<hash_scheme>(e.scheme),
+                       static_cast<hash_family>(e.family), e.seed);
+  try {
+    return std::unique_ptr<basic_bloom_filter>(new basic_bloom_filter(
+      config, view(i), e.partition != 0, static_cast<reduction>(e.reduction)));
+  } catch (std::invalid_argument const& x) {
+    throw std::runtime_error(std::string(x.what()) + " in entry "
+                             + std::to_string(i) + " of " + filename_);
+  }
+}
+
+std::unique_ptr<basic_bloom_filter>
+archive::load(size_t i, std::shared_ptr<storage_allocator> allocator) const {
+  return std::unique_ptr<basic_bloom_filter>(
+    new basic_bloom_filter(*open(i), std::move(allocator)));
+}
+
+std::vector<std::unique_ptr<basic_bloom_filter>>
+archive::load(std::vector<size_t> const& indices, size_t threads) const {
+  for (auto i : indices)
+    at(i);
+  std::vector<std::unique_ptr<basic_bloom_filter>> filters(indices.size());
+  std::vector<std::exception_ptr> errors(indices.size());
+  detail::parallel_for(indices.size(), threads, [&](size_t begin, size_t end) {
+    for (auto j = begin; j < end; ++j) {
+      try {
+        filters[j] = load(indices[j]);
+      } catch (...) {
+        errors[j] = std::current_exception();
+      }
+    }
+  });
+  for (auto& e : errors)
+    if (e)
+      std::rethrow_exception(e);
+  return filters;
+}
+
+detail::archive_entry const& archive::at(size_t i) const {
+  if (i >= size_)
+    throw std::out_of_range("no filter " + std::to_string(i) + " in "
+                            + filename_);
+  return entries_[i];
+}
+
+bitvector archive::view(size_t i) const {
+  auto& e = entries_[i];
+  auto bytes = payload_bytes(e.cells);
+  if (bytes == 0)
+    return bitvector(0);
+  // Each view maps its own pages privately, so that adding to it copies the
+  // modified pages instead of changing the file or other views.
+  auto p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, *file_,
+                static_cast<off_t>(e.offset));
+  if (p == MAP_FAILED)
+    throw std::runtime_error("cannot map entry " + std::to_string(i) + " of "
+                             + filename_);
+  std::shared_ptr<void> mapping(p, [bytes](void* q) { munmap(q, bytes); });
+  return bitvector(static_cast<bitvector::block_type*>(p), e.cells, mapping);
+}
+
+} // namespace bf
@@ -0,0 +1,99 @@
+#include <bf/bit_sliced_index.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace bf {
+
+bit_sliced_index::bit_sliced_index(
+  std::vector<basic_bloom_filter const*> const& filters) {
+  if (filters.empty())
+    throw std::invalid_argument("bit-sliced index needs at least one filter");
+  init(*filters[0], filters.size());
+  for (size_t j = 0; j < filters.size(); ++j)
+    insert(*filters[j], j);
+}
+
+bit_sliced_index::bit_sliced_index(std::vector<std::string> const& filenames) {
+  if (filenames.empty())
+    throw std::invalid_argument("bit-sliced index needs at least one filter");
+  for (size_t j = 0; j < filenames.size(); ++j) {
+    bool has_header;
+    unsigned long long K, z;
+    bool canonical;
+    basic_bloom_filter filter(filenames[j], has_header, K, z, canonical);
+    if (j == 0)
+      init(filter, filenames.size());
+    insert(filter, j);
+  }
+}
+
+bitvector bit_sliced_index::lookup(object const& o) const {
+  bitvector result(samples_);
+  auto acc = result.blocks();
+  auto digests = hasher_(o);
+  auto row = &rows_[reduce(digests[0], cells_, reduction_) * words_per_row_];
+  std::copy(row, row + words_per_row_, acc);
+  for (size_t i = 1; i < digests.size(); ++i) {
+    row = &rows_[reduce(digests[i], cells_, reduction_) * words_per_row_];
+    // A plain word-wise loop, which the compiler vectorizes.
+    uint64_t any = 0;
+    for (size_t w = 0; w < words_per_row_; ++w) {
+      acc[w] &= row[w];
+      any |= acc[w];
+    }
+    if (any == 0)
+      break;
+  }
+  return result;
+}
+
+std::vector<size_t> bit_sliced_index::count(
+  std::vector<object> const& objects) const {
+  std::vector<size_t> counts(samples_, 0);
+  for (auto& o : objects) {
+    auto hits = lookup(o);
+    auto blocks = hits.blocks();
+    for (size_t w = 0; w < hits.blocks_count(); ++w)
+      for (auto x = blocks[w]; x != 0; x &= x - 1)
+        ++counts[w * 64 + __builtin_ctzll(x)];
+  }
+  return counts;
+}
+
+size_t bit_sliced_index::samples() const {
+  return samples_;
+}
+
+size_t bit_sliced_index::cells() const {
+  return cells_;
+}
+
+void bit_sliced_index::init(basic_bloom_filter const& first, size_t samples) {
+  hasher_ = first.hasher_function();
+  config_ = first.configuration();
+  reduction_ = first.reduction_mode();
+  cells_ = first.storage().size();
+  samples_ = samples;
+  words_per_row_ = (samples + 63) / 64;
+  rows_.assign(cells_ * words_per_row_, 0);
+}
+
+void bit_sliced_index::insert(basic_bloom_filter const& filter,
+                              size_t sample) {
+  if (filter.storage().size() != cells_
+      || filter.configuration() != config_
+      || filter.reduction_mode() != reduction_)
+    throw std::invalid_argument(
+      "filter differs in cells, hasher configuration or reduction");
+  if (filter.partitioned())
+    throw std::invalid_argument("partitioned filters cannot be indexed");
+  auto& bits = filter.storage();
+  auto column = sample / 64;
+  auto mask = uint64_t(1) << (sample % 64);
+  for (size_t b = 0; b < bits.blocks_count(); ++b)
+    for (auto x = bits.blocks()[b]; x != 0; x &= x - 1)
+      rows_[(b * 64 + __builtin_ctzll(x)) * words_per_row_ + column] |= mask;
+}
+
+} // namespace bf
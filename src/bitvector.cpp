@@ -0,0 +1,103 @@
+#include <bf/bitvector.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace bf {
+
+constexpr size_t bitvector::bits_per_block;
+
+bitvector::bitvector(size_t size,
+                     std::shared_ptr<storage_allocator> allocator)
+    : size_(size),
+      blocks_count_((size + bits_per_block - 1) / bits_per_block),
+      allocator_(allocator ? std::move(allocator) : default_allocator()) {
+  blocks_ = static_cast<block_type*>(
+    allocator_->allocate(blocks_count_ * sizeof(block_type)));
+}
+
+bitvector::bitvector(block_type* blocks, size_t size,
+                     std::shared_ptr<void> owner)
+    : size_(size),
+      blocks_count_((size + bits_per_block - 1) / bits_per_block),
+      blocks_(blocks),
+      owner_(std::move(owner)) {
+}
+
+bitvector::bitvector(bitvector const& other)
+    : bitvector(other.size_, other.allocator_) {
+  std::copy(other.blocks_, other.blocks_ + blocks_count_, blocks_);
+}
+
+bitvector::bitvector(bitvector&& other) {
+  swap(other);
+}
+
+bitvector& bitvector::operator=(bitvector const& other) {
+  if (this != &other) {
+    bitvector copy(other);
+    swap(copy);
+  }
+  return *this;
+}
+
+bitvector& bitvector::operator=(bitvector&& other) {
+  bitvector moved(std::move(other));
+  swap(moved);
+  return *this;
+}
+
+bitvector::~bitvector() {
+  release();
+}
+
+std::shared_ptr<storage_allocator> const& bitvector::allocator() const {
+  return allocator_;
+}
+
+size_t bitvector::size() const {
+  return size_;
+}
+
+size_t bitvector::blocks_count() const {
+  return blocks_count_;
+}
+
+bitvector::block_type* bitvector::blocks() {
+  return blocks_;
+}
+
+bitvector::block_type const* bitvector::blocks() const {
+  return blocks_;
+}
+
+void bitvector::clear() {
+  std::fill(blocks_, blocks_ + blocks_count_, 0);
+}
+
+void bitvector::swap(bitvector& other) {
+  using std::swap;
+  swap(size_, other.size_);
+  swap(blocks_count_, other.blocks_count_);
+  swap(blocks_, other.blocks_);
+  swap(allocator_, other.allocator_);
+  swap(owner_, other.owner_);
+}
+
+void bitvector::release() {
+  if (blocks_ != nullptr && allocator_)
+    allocator_->deallocate(blocks_, blocks_count_ * sizeof(block_type));
+  blocks_ = nullptr;
+  owner_.reset();
+}
+
+bool operator==(bitvector const& x, bitvector const& y) {
+  return x.size_ == y.size_
+         && std::equal(x.blocks_, x.blocks_ + x.blocks_count_, y.blocks_);
+}
+
+bool operator!=(bitvector const& x, bitvector const& y) {
+  return !(x == y);
+}
+
+} // namespace bf
@@ -1,8 +1,15 @@
 #include <bf/bloom_filter/basic.hpp>
+#include <bf/detail/parallel.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 namespace hidden_bf {
 
@@ -30,23 +37,88 @@ void skipChar(std::ifstream& fin, std::size_t length) {
     }
 }
 
-std::vector<bool> loadBoolVectorFromDisk(std::ifstream& fin) {
-    std::vector<bool> v;
-    std::vector<bool>::size_type n;
-    fin.read((char*)&n, sizeof(std::vector<bool>::size_type));
-    v.resize(n);
-    for (std::vector<bool>::size_type i = 0; i < n;) {
-        unsigned char aggr;
-        fin.read((char*)&aggr, sizeof(unsigned char));
-        for (unsigned char mask = 1; mask > 0 && i < n; ++i, mask <<= 1)
-            v.at(i) = aggr & mask;
-    }
+bf::bitvector loadBitvectorFromDisk(std::ifstream& fin, std::shared_ptr<bf::storage_allocator> allocator) {
+    std::size_t n;
+    fin.read((char*)&n, sizeof(n));
+    bf::bitvector v(n, std::move(allocator));
+    // Bits are stored byte-wise, least significant bit first, which matches
+    // the in-memory layout of the blocks.
+    fin.read((char*)v.blocks(), (n + 7) / 8);
+    return v;
+}
+
+// Version 4 stores whole blocks, so that the bits start at an 8-byte offset.
+bf::bitvector loadBlocksFromDisk(std::ifstream& fin, std::shared_ptr<bf::storage_allocator> allocator) {
+    std::size_t n;
+    fin.read((char*)&n, sizeof(n));
+    bf::bitvector v(n, std::move(allocator));
+    fin.read((char*)v.blocks(), v.blocks_count() * sizeof(bf::bitvector::block_type));
     return v;
 }
 
+void writeBlocksToDisk(std::ostream& fout, bf::bitvector const& v) {
+    std::size_t n = v.size();
+    fout.write((const char*)&n, sizeof(n));
+    fout.write((const char*)v.blocks(), v.blocks_count() * sizeof(bf::bitvector::block_type));
+}
+
+// Version 4 pads the header after `canonical` to an 8-byte boundary.
+constexpr std::size_t header_padding = 3;
+
+// The tags of the (tag, value) parameter pairs of version 4. A loader
+// rejects tags it does not know, since they may change the bit positions.
+enum parameter_tag : uint64_t {
+    tag_reduction = 1,
+    tag_partition = 2,
+    tag_hash_scheme = 3,
+    tag_hash_family = 4,
+    tag_seed = 5,
+};
+
+// Reads from a buffer in memory.
+struct memory_buffer : std::streambuf {
+    memory_buffer(char* p, std::size_t n) {
+        setg(p, p, p + n);
+    }
+
+    std::size_t consumed() const {
+        return gptr() - eback();
+    }
+};
+
+size_t next_power_of_two(size_t x) {
+    size_t p = 1;
+    while (p < x)
+        p <<= 1;
+    return p;
+}
+
 }  // namespace hidden_bf
 
 namespace bf {
+constexpr size_t basic_bloom_filter::lock_stripes;
+constexpr size_t basic_bloom_filter::batch_size;
+constexpr size_t basic_bloom_filter::max_prefetch;
+constexpr size_t basic_bloom_filter::parallel_chunk;
+constexpr size_t basic_bloom_filter::snapshot_segment;
+constexpr size_t basic_bloom_filter::delta_region;
+
+// The copy of the bits a pending snapshot writes, and the copy state of each
+// segment: 0 while it is to be copied, 1 while it is being copied and 2 once
+// it is copied. The state outlives the snapshots, so that an add which saw a
+// snapshot in progress never touches freed memory; after a snapshot, all
+// segments remain in state 2.
+struct basic_bloom_filter::snapshot_state {
+    explicit snapshot_state(size_t n) : count(n), segments(new std::atomic<uint8_t>[n]) {
+        for (size_t i = 0; i < n; ++i)
+            segments[i].store(2, std::memory_order_relaxed);
+    }
+
+    size_t count;
+    std::unique_ptr<std::atomic<uint8_t>[]> segments;
+    bitvector* copy = nullptr;
+};
+
 basic_bloom_filter make_filter(double fp, size_t capacity) {
     size_t required_cells = basic_bloom_filter::m(fp, capacity);
     size_t optimal_k = basic_bloom_filter::k(required_cells, capacity);
@@ -59,6 +131,12 @@ basic_bloom_filter* make_filter_ptr(double fp, size_t capacity) {
     return new basic_bloom_filter(optimal_k, required_cells);
 }
 
+basic_bloom_filter* make_partitioned_filter_ptr(double fp, size_t capacity, hasher_config config) {
+    size_t required_cells = basic_bloom_filter::m(fp, capacity);
+    config.k = basic_bloom_filter::k(required_cells, capacity);
+    return new basic_bloom_filter(config, required_cells, true, reduction::mask);
+}
+
 size_t basic_bloom_filter::m(double fp, size_t capacity) {
     auto ln2 = std::log(2);
     return std::ceil(-(capacity * std::log(fp) / ln2 / ln2));
@@ -69,17 +147,97 @@ size_t basic_bloom_filter::k(size_t cells, size_t capacity) {
     return std::ceil(frac * std::log(2));
 }
 
-basic_bloom_filter::basic_bloom_filter(size_t numberOfHashFunctions, size_t cells, bool partition)
-    : hasher_(make_hasher(numberOfHashFunctions)), bits_(cells), partition_(partition) {
-    numberOfHashFunctions_ = numberOfHashFunctions;
+size_t basic_bloom_filter::rounded_cells(size_t k, size_t cells, bool partition, reduction r) {
+    if (partition) {
+        auto parts = (cells + k - 1) / k;
+        if (r == reduction::mask)
+            parts = hidden_bf::next_power_of_two(parts);
+        return parts * k;
+    }
+    return r == reduction::mask ? hidden_bf::next_power_of_two(cells) : cells;
+}
+
+basic_bloom_filter::basic_bloom_filter(size_t numberOfHashFunctions, size_t cells, bool partition, reduction r)
+    : basic_bloom_filter(hasher_config(numberOfHashFunctions), cells, partition, r) {
+}
+
+basic_bloom_filter::basic_bloom_filter(hasher_config const& config, size_t cells, bool partition, reduction r,
+                                       std::shared_ptr<storage_allocator> allocator)
+    : batch_(config), hasher_(batch_), partition_(partition), reduction_(r), scheme_(config.scheme), family_(config.family), seed_(config.seed) {
+    numberOfHashFunctions_ = config.k;
+    bits_ = bitvector(rounded_cells(config.k, cells, partition, r), std::move(allocator));
+    update_range();
+}
+
+basic_bloom_filter::basic_bloom_filter(basic_bloom_filter const& other,
+                                       std::shared_ptr<storage_allocator> allocator)
+    : basic_bloom_filter(other.configuration(), other.bits_.size(), other.partition_,
+                         other.reduction_, std::move(allocator)) {
+    std::copy(other.bits_.blocks(), other.bits_.blocks() + other.bits_.blocks_count(),
+              bits_.blocks());
+}
+
+basic_bloom_filter::basic_bloom_filter(hasher_config const& config, bitvector bits, bool partition,
+                                       reduction r)
+    : batch_(config), hasher_(batch_), bits_(std::move(bits)), partition_(partition), reduction_(r),
+      scheme_(config.scheme), family_(config.family), seed_(config.seed),
+      numberOfHashFunctions_(config.k) {
+    if (partition && bits_.size() % config.k != 0)
+        throw std::invalid_argument("cells are not a multiple of the partitions");
+    update_range();
+    if (r == reduction::mask && range_ != hidden_bf::next_power_of_two(range_))
+        throw std::invalid_argument("mask reduction requires a power of two cells");
+}
+
+basic_bloom_filter::basic_bloom_filter(uint8_t* buffer, size_t size, unsigned long long& K,
+                                       unsigned long long& z, bool& canonical)
+    : partition_(false) {
+    if (reinterpret_cast<uintptr_t>(buffer) % alignof(bitvector::block_type) != 0)
+        throw std::invalid_argument("unaligned Bloom filter buffer");
+    auto data = reinterpret_cast<char*>(buffer);
+    if (size < uuid_4_0_0.size() || std::string(data, uuid_4_0_0.size()) != uuid_4_0_0)
+        throw std::runtime_error("no Bloom filter in buffer");
+    hidden_bf::memory_buffer memory(data, size);
+    std::istream in(&memory);
+    in.ignore(uuid_4_0_0.size());
+    readHeader(in, K, z, canonical, "buffer");
+    uint64_t n = 0;
+    in.read(reinterpret_cast<char*>(&n), sizeof(n));
+    auto offset = memory.consumed();
+    auto blocks = (n + bitvector::bits_per_block - 1) / bitvector::bits_per_block;
+    if (!in || blocks > (size - offset) / sizeof(bitvector::block_type))
+        throw std::runtime_error("truncated Bloom filter in buffer");
+    adopt(bitvector(reinterpret_cast<bitvector::block_type*>(data + offset), n), "buffer");
 }
 
+void basic_bloom_filter::adopt(bitvector bits, std::string const& source) {
+    // Legacy headers are not checked by readHeader.
+    if (numberOfHashFunctions_ == 0)
+        throw std::runtime_error("no hash functions in " + source);
+    if (partition_ && bits.size() % numberOfHashFunctions_ != 0)
+        throw std::runtime_error("cells are not a multiple of the partitions in " + source);
+    bits_ = std::move(bits);
+    batch_ = batch_hasher(configuration());
+    hasher_ = batch_;
+    update_range();
+    if (reduction_ == reduction::mask && range_ != hidden_bf::next_power_of_two(range_))
+        throw std::runtime_error("mask reduction requires a power of two cells in " + source);
+}
+
+basic_bloom_filter::basic_bloom_filter(basic_bloom_filter&& other)
+    : partition_(false) {
+    swap(other);
+}
+
+basic_bloom_filter::~basic_bloom_filter() = default;
+
 basic_bloom_filter::basic_bloom_filter(std::string filename,
                                        bool& hasKzandcanonicalvalues,
                                        unsigned long long& K,
                                        unsigned long long& z,
                                        bool& canonical,
-                                       bool partition) {
+                                       bool partition,
+                                       std::shared_ptr<storage_allocator> allocator) {
     partition_ = partition;
 
     if (!hidden_bf::file_exists(filename)) {
@@ -94,73 +252,292 @@ basic_bloom_filter::basic_bloom_filter(std::string filename,
     std::size_t sizeOfUuid = uuid_2_0_0.length();
     std::string uuid = hidden_bf::getUUID(filename, sizeOfUuid);
     std::ifstream fin(filename, std::ios::out | std::ofstream::binary);
-    if (uuid == uuid_3_0_0) {
+    hasKzandcanonicalvalues = true;
+    bitvector bits;
+    if (uuid == uuid_4_0_0) {
+        hidden_bf::skipChar(fin, sizeOfUuid);
+        readHeader(fin, K, z, canonical, filename);
+        bits = hidden_bf::loadBlocksFromDisk(fin, allocator);
+        if (!fin)
+            throw std::runtime_error("truncated Bloom filter in " + filename);
+    } else if (uuid == uuid_3_0_0) {
         hidden_bf::skipChar(fin, sizeOfUuid);                                                        // skip first char
         fin.read(reinterpret_cast<char*>(&K), sizeof(K));                                            // read K
         fin.read(reinterpret_cast<char*>(&z), sizeof(z));                                            // read z
         fin.read(reinterpret_cast<char*>(&canonical), sizeof(canonical));                            // read canonical
         fin.read(reinterpret_cast<char*>(&numberOfHashFunctions_), sizeof(numberOfHashFunctions_));  // read canonical
-        bits_ = hidden_bf::loadBoolVectorFromDisk(fin);
+        bits = hidden_bf::loadBitvectorFromDisk(fin, allocator);
     } else if (uuid == uuid_2_0_0) {
         hidden_bf::skipChar(fin, sizeOfUuid);
         fin.read(reinterpret_cast<char*>(&K), sizeof(K));                  // read K
         fin.read(reinterpret_cast<char*>(&z), sizeof(z));                  // read z
         fin.read(reinterpret_cast<char*>(&canonical), sizeof(canonical));  // read canonical
         numberOfHashFunctions_ = 1;
-        bits_ = hidden_bf::loadBoolVectorFromDisk(fin);
+        bits = hidden_bf::loadBitvectorFromDisk(fin, allocator);
     } else {
         hasKzandcanonicalvalues = false;
         K = 0;
         z = 0;
         canonical = false;
         numberOfHashFunctions_ = 1;
-        bits_ = hidden_bf::loadBoolVectorFromDisk(fin);
+        bits = hidden_bf::loadBitvectorFromDisk(fin, allocator);
+    }
+    // Earlier versions always reduced with a modulo.
+    if (uuid != uuid_4_0_0)
+        reduction_ = reduction::modulo;
+    adopt(std::move(bits), filename);
+}
+
+void basic_bloom_filter::readHeader(std::istream& fin, unsigned long long& K, unsigned long long& z,
+                                    bool& canonical, std::string const& source) {
+    fin.read(reinterpret_cast<char*>(&K), sizeof(K));
+    fin.read(reinterpret_cast<char*>(&z), sizeof(z));
+    fin.read(reinterpret_cast<char*>(&canonical), sizeof(canonical));
+    fin.ignore(hidden_bf::header_padding);
+    fin.read(reinterpret_cast<char*>(&numberOfHashFunctions_), sizeof(numberOfHashFunctions_));
+    if (fin && numberOfHashFunctions_ == 0)
+        throw std::runtime_error("no hash functions in " + source);
+    uint64_t parameters = 0;
+    fin.read(reinterpret_cast<char*>(&parameters), sizeof(parameters));
+    for (uint64_t i = 0; i < parameters && fin; ++i) {
+        uint64_t tag, value;
+        fin.read(reinterpret_cast<char*>(&tag), sizeof(tag));
+        fin.read(reinterpret_cast<char*>(&value), sizeof(value));
+        switch (tag) {
+            case hidden_bf::tag_reduction:
+                if (value > static_cast<uint64_t>(reduction::mask))
+                    throw std::runtime_error("invalid reduction in " + source);
+                reduction_ = static_cast<reduction>(value);
+                break;
+            case hidden_bf::tag_partition:
+                partition_ = value != 0;
+                break;
+            case hidden_bf::tag_hash_scheme:
+                if (value > static_cast<uint64_t>(hash_scheme::enhanced_double))
+                    throw std::runtime_error("invalid hash scheme in " + source);
+                scheme_ = static_cast<hash_scheme>(value);
+                break;
+            case hidden_bf::tag_hash_family:
+                if (value > static_cast<uint64_t>(hash_family::wyhash))
+                    throw std::runtime_error("invalid hash family in " + source);
+                family_ = static_cast<hash_family>(value);
+                break;
+            case hidden_bf::tag_seed:
+                seed_ = value;
+                break;
+            default:
+                throw std::runtime_error("unknown parameter " + std::to_string(tag) + " in " + source);
+        }
+    }
+    if (!fin)
+        throw std::runtime_error("truncated Bloom filter header in " + source);
+}
+
+size_t basic_bloom_filter::position(size_t i, digest d) const {
+    auto p = reduce(d, range_, reduction_);
+    return partition_ ? i * range_ + p : p;
+}
+
+void basic_bloom_filter::update_range() {
+    if (partition_) {
+        assert(bits_.size() % numberOfHashFunctions_ == 0);
+        range_ = bits_.size() / numberOfHashFunctions_;
+    } else {
+        range_ = bits_.size();
     }
-    hasher_ = make_hasher(numberOfHashFunctions_);
 }
 
 void basic_bloom_filter::add(object const& o) {
     auto digests = hasher_(o);
-    if (partition_) {
-        assert(bits_.size() % digests.size() == 0);
+    if (snapshotting_.load(std::memory_order_acquire))
+        for (size_t i = 0; i < digests.size(); ++i)
+            preserve(position(i, digests[i]));
+    if (concurrent_) {
+        for (size_t i = 0; i < digests.size(); ++i)
+            bits_.atomic_test_and_set(position(i, digests[i]));
+    } else {
+        for (size_t i = 0; i < digests.size(); ++i)
+            bits_.set(position(i, digests[i]));
+    }
+    if (tracking_)
+        for (size_t i = 0; i < digests.size(); ++i)
+            markDirty(position(i, digests[i]));
+}
+
+size_t basic_bloom_filter::lookup(object const& o) const {
+    return lookup_digests(hasher_(o));
+}
 
-        auto parts = bits_.size() / digests.size();
-        for (size_t i = 0; i < digests.size(); ++i) {
-            bits_[i * parts + (digests[i] % parts)] = true;
+void basic_bloom_filter::add(object const* objects, size_t n) {
+    auto k = numberOfHashFunctions_;
+    std::vector<digest> digests(std::min(n, batch_size) * k);
+    for (size_t first = 0; first < n; first += batch_size) {
+        auto count = std::min(batch_size, n - first);
+        batch_(objects + first, count, digests.data());
+        // Reduce all digests first, so that the cache misses of a batch overlap.
+        for (size_t i = 0; i < count * k; ++i) {
+            digests[i] = position(i % k, digests[i]);
+            __builtin_prefetch(bits_.blocks() + digests[i] / bitvector::bits_per_block, 1);
         }
+        if (snapshotting_.load(std::memory_order_acquire))
+            for (size_t i = 0; i < count * k; ++i)
+                preserve(digests[i]);
+        if (concurrent_) {
+            for (size_t i = 0; i < count * k; ++i)
+                bits_.atomic_test_and_set(digests[i]);
+        } else {
+            for (size_t i = 0; i < count * k; ++i)
+                bits_.set(digests[i]);
+        }
+        if (tracking_)
+            for (size_t i = 0; i < count * k; ++i)
+                markDirty(digests[i]);
+    }
+}
 
-    } else {
-        for (auto d : digests)
-            bits_[d % bits_.size()] = true;
+void basic_bloom_filter::add(object const* objects, size_t n, size_t threads) {
+    auto k = numberOfHashFunctions_;
+    // Partitions that share a block would race on it.
+    auto disjoint = partition_ && range_ % bitvector::bits_per_block == 0;
+    std::vector<digest> digests(std::min(n, parallel_chunk) * k);
+    for (size_t first = 0; first < n; first += parallel_chunk) {
+        auto count = std::min(parallel_chunk, n - first);
+        detail::parallel_for(count, threads, [&](size_t begin, size_t end) {
+            batch_(objects + first + begin, end - begin, digests.data() + begin * k);
+        });
+        if (snapshotting_.load(std::memory_order_acquire))
+            for (size_t i = 0; i < count * k; ++i)
+                preserve(position(i % k, digests[i]));
+        if (disjoint) {
+            // Other threads of a concurrent filter may write the same blocks.
+            detail::parallel_for(k, threads, [&](size_t begin, size_t end) {
+                for (auto j = begin; j < end; ++j)
+                    for (size_t i = 0; i < count; ++i)
+                        if (concurrent_)
+                            bits_.atomic_test_and_set(position(j, digests[i * k + j]));
+                        else
+                            bits_.set(position(j, digests[i * k + j]));
+            });
+        } else {
+            detail::parallel_for(count, threads, [&](size_t begin, size_t end) {
+                for (auto i = begin * k; i < end * k; ++i)
+                    bits_.atomic_test_and_set(position(i % k, digests[i]));
+            });
+        }
+        if (tracking_)
+            for (size_t i = 0; i < count * k; ++i)
+                markDirty(position(i % k, digests[i]));
     }
 }
 
-size_t basic_bloom_filter::lookup(object const& o) const {
-    auto digests = hasher_(o);
-    if (partition_) {
-        assert(bits_.size() % digests.size() == 0);
-        auto parts = bits_.size() / digests.size();
-        for (size_t i = 0; i < digests.size(); ++i) {
-            if (!bits_[i * parts + (digests[i] % parts)])
-                return 0;
+void basic_bloom_filter::lookup(object const* objects, size_t n, size_t* results) const {
+    auto k = numberOfHashFunctions_;
+    std::vector<digest> digests(std::min(n, batch_size) * k);
+    for (size_t first = 0; first < n; first += batch_size) {
+        auto count = std::min(batch_size, n - first);
+        batch_(objects + first, count, digests.data());
+        for (size_t i = 0; i < count * k; ++i) {
+            digests[i] = position(i % k, digests[i]);
+            __builtin_prefetch(bits_.blocks() + digests[i] / bitvector::bits_per_block);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t found = 1;
+            for (size_t j = 0; j < k && found; ++j) {
+                auto p = digests[i * k + j];
+                found = concurrent_ ? bits_.atomic_test(p) : bits_[p];
+            }
+            results[first + i] = found;
         }
+    }
+}
 
+size_t basic_bloom_filter::lookup_digests(std::vector<digest> const& digests) const {
+    auto k = digests.size();
+    if (k > 1 && k <= max_prefetch) {
+        // Issue all k loads before testing the first bit, so that their cache
+        // misses overlap.
+        size_t positions[max_prefetch];
+        for (size_t i = 0; i < k; ++i) {
+            positions[i] = position(i, digests[i]);
+            __builtin_prefetch(bits_.blocks() + positions[i] / bitvector::bits_per_block);
+        }
+        for (size_t i = 0; i < k; ++i)
+            if (!(concurrent_ ? bits_.atomic_test(positions[i]) : bits_[positions[i]]))
+                return 0;
+        return 1;
+    }
+    if (concurrent_) {
+        for (size_t i = 0; i < digests.size(); ++i)
+            if (!bits_.atomic_test(position(i, digests[i])))
+                return 0;
     } else {
-        for (auto d : digests)
-            if (!bits_[d % bits_.size()])
+        for (size_t i = 0; i < digests.size(); ++i)
+            if (!bits_[position(i, digests[i])])
                 return 0;
     }
-
     return 1;
 }
 
+bool basic_bloom_filter::add_if_absent(object const& o) {
+    auto digests = hasher_(o);
+    bool fresh = false;
+    if (snapshotting_.load(std::memory_order_acquire))
+        for (size_t i = 0; i < digests.size(); ++i)
+            preserve(position(i, digests[i]));
+    if (!concurrent_) {
+        for (size_t i = 0; i < digests.size(); ++i)
+            fresh |= !bits_.test_and_set(position(i, digests[i]));
+        if (tracking_ && fresh)
+            for (size_t i = 0; i < digests.size(); ++i)
+                markDirty(position(i, digests[i]));
+        return fresh;
+    }
+    // Two threads inserting the same element set the same bits, but may
+    // interleave such that each one flips some of them. Serializing them on a
+    // lock selected by the first digest ensures that exactly one sees a
+    // flipped bit; unrelated elements rarely share a lock.
+    auto stripe = (digests[0] * 0x9e3779b97f4a7c15ULL) >> 32;
+    auto& lock = locks_[stripe % lock_stripes];
+    while (lock.exchange(true, std::memory_order_acquire))
+        ;
+    for (size_t i = 0; i < digests.size(); ++i)
+        fresh |= !bits_.atomic_test_and_set(position(i, digests[i]));
+    lock.store(false, std::memory_order_release);
+    if (tracking_ && fresh)
+        for (size_t i = 0; i < digests.size(); ++i)
+            markDirty(position(i, digests[i]));
+    return fresh;
+}
+
+void basic_bloom_filter::concurrent(bool enable) {
+    if (enable && !locks_)
+        locks_.reset(new std::atomic<bool>[lock_stripes]());
+    concurrent_ = enable;
+}
+
+bool basic_bloom_filter::concurrent() const {
+    return concurrent_;
+}
+
 void basic_bloom_filter::swap(basic_bloom_filter& other) {
     using std::swap;
+    swap(batch_, other.batch_);
     swap(hasher_, other.hasher_);
-    swap(bits_, other.bits_);
+    bits_.swap(other.bits_);
+    swap(reduction_, other.reduction_);
+    swap(scheme_, other.scheme_);
+    swap(family_, other.family_);
+    swap(seed_, other.seed_);
+    swap(range_, other.range_);
+    swap(concurrent_, other.concurrent_);
+    swap(locks_, other.locks_);
+    swap(partition_, other.partition_);
+    swap(numberOfHashFunctions_, other.numberOfHashFunctions_);
+    swap(tracking_, other.tracking_);
+    dirty_.swap(other.dirty_);
 }
 
-std::vector<bool> const& basic_bloom_filter::storage() const {
+bitvector const& basic_bloom_filter::storage() const {
     return bits_;
 }
 hasher const& basic_bloom_filter::hasher_function() const {
@@ -171,47 +548,229 @@ size_t basic_bloom_filter::getNumberOfHashFunctions() const {
     return numberOfHashFunctions_;
 }
 
+hasher_config basic_bloom_filter::configuration() const {
+    return hasher_config(numberOfHashFunctions_, scheme_, family_, seed_);
+}
+
+bool basic_bloom_filter::partitioned() const {
+    return partition_;
+}
+
+reduction basic_bloom_filter::reduction_mode() const {
+    return reduction_;
+}
+
 void basic_bloom_filter::save(const std::string& filename,
                               const unsigned long long& K,
                               const unsigned long long& z,
                               const bool& canonical) {
+    if (tracking_)
+        takeDirty();
     std::ofstream fout(filename, std::ios::out | std::ofstream::binary);
-    // write the UUID
-    for (char& c : uuid_3_0_0) {
-        fout.write((const char*)&c, sizeof(unsigned char));
+    writeHeader(fout, K, z, canonical);
+    // write the vector
+    hidden_bf::writeBlocksToDisk(fout, bits_);
+    fout.flush();
+    fout.close();
+}
+
+std::future<void> basic_bloom_filter::save_async(std::string const& filename, unsigned long long K,
+                                                 unsigned long long z, bool canonical) {
+    // Wait until a previous snapshot has captured its bits.
+    while (snapshotting_.load(std::memory_order_acquire))
+        std::this_thread::yield();
+    std::ostringstream header;
+    writeHeader(header, K, z, canonical);
+    auto segments = (bits_.blocks_count() + snapshot_segment - 1) / snapshot_segment;
+    if (!snapshot_ || snapshot_->count != segments)
+        snapshot_.reset(new snapshot_state(segments));
+    // Fresh pages read as zero without being touched, so the copy only costs
+    // memory as segments are copied into it.
+    auto copy = std::make_shared<bitvector>(bits_.size());
+    snapshot_->copy = copy.get();
+    for (size_t i = 0; i < segments; ++i)
+        snapshot_->segments[i].store(0, std::memory_order_relaxed);
+    // Changes after this point belong to the next delta.
+    if (tracking_)
+        takeDirty();
+    snapshotting_.store(true, std::memory_order_release);
+    auto data = header.str();
+    return std::async(std::launch::async, [this, copy, data, filename] {
+        for (size_t i = 0; i < snapshot_->count; ++i)
+            preserveSegment(i);
+        snapshotting_.store(false, std::memory_order_release);
+        std::ofstream fout(filename, std::ios::out | std::ofstream::binary);
+        fout.write(data.data(), data.size());
+        hidden_bf::writeBlocksToDisk(fout, *copy);
+        fout.close();
+        if (!fout)
+            throw std::runtime_error("cannot write Bloom filter " + filename);
+    });
+}
+
+size_t basic_bloom_filter::serialized_size() const {
+    std::ostringstream header;
+    writeHeader(header, 0, 0, false);
+    return header.str().size() + sizeof(uint64_t) + bits_.blocks_count() * sizeof(bitvector::block_type);
+}
+
+size_t basic_bloom_filter::serialize_to(uint8_t* buffer, size_t size, unsigned long long K,
+                                        unsigned long long z, bool canonical) const {
+    std::ostringstream header;
+    writeHeader(header, K, z, canonical);
+    auto data = header.str();
+    uint64_t n = bits_.size();
+    auto bytes = bits_.blocks_count() * sizeof(bitvector::block_type);
+    auto total = data.size() + sizeof(n) + bytes;
+    if (size < total)
+        throw std::length_error("Bloom filter buffer too small");
+    std::memcpy(buffer, data.data(), data.size());
+    std::memcpy(buffer + data.size(), &n, sizeof(n));
+    std::memcpy(buffer + data.size() + sizeof(n), bits_.blocks(), bytes);
+    return total;
+}
+
+void basic_bloom_filter::preserve(size_t p) {
+    auto segment = p / bitvector::bits_per_block / snapshot_segment;
+    if (snapshot_->segments[segment].load(std::memory_order_acquire) != 2)
+        preserveSegment(segment);
+}
+
+void basic_bloom_filter::preserveSegment(size_t segment) {
+    auto& state = snapshot_->segments[segment];
+    uint8_t expected = 0;
+    if (state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+        auto first = segment * snapshot_segment;
+        auto last = std::min(first + snapshot_segment, bits_.blocks_count());
+        auto from = bits_.blocks();
+        auto to = snapshot_->copy->blocks();
+        // Adds that did not see the snapshot may still set bits.
+        for (auto i = first; i < last; ++i)
+            to[i] = __atomic_load_n(from + i, __ATOMIC_RELAXED);
+        state.store(2, std::memory_order_release);
+        return;
+    }
+    while (state.load(std::memory_order_acquire) != 2)
+        std::this_thread::yield();
+}
+
+void basic_bloom_filter::markDirty(size_t p) {
+    auto region = p / bitvector::bits_per_block / delta_region;
+    if (!concurrent_) {
+        dirty_.set(region);
+        return;
     }
+    // Releases the bit set before, for the thread that takes the region.
+    auto mask = bitvector::block_type(1) << (region % bitvector::bits_per_block);
+    __atomic_fetch_or(dirty_.blocks() + region / bitvector::bits_per_block, mask, __ATOMIC_RELEASE);
+}
+
+std::vector<size_t> basic_bloom_filter::takeDirty() {
+    std::vector<size_t> regions;
+    auto blocks = dirty_.blocks();
+    for (size_t i = 0; i < dirty_.blocks_count(); ++i) {
+        if (__atomic_load_n(blocks + i, __ATOMIC_RELAXED) == 0)
+            continue;
+        auto b = __atomic_exchange_n(blocks + i, 0, __ATOMIC_ACQUIRE);
+        for (; b != 0; b &= b - 1)
+            regions.push_back(i * bitvector::bits_per_block + __builtin_ctzll(b));
+    }
+    return regions;
+}
+
+void basic_bloom_filter::track_changes(bool enable) {
+    tracking_ = enable;
+    auto regions = (bits_.blocks_count() + delta_region - 1) / delta_region;
+    dirty_ = enable ? bitvector(regions) : bitvector();
+}
+
+bool basic_bloom_filter::tracking_changes() const {
+    return tracking_;
+}
+
+void basic_bloom_filter::save_delta(std::string const& filename) {
+    if (!tracking_)
+        throw std::logic_error("changes are not tracked");
+    auto regions = takeDirty();
+    std::ofstream fout(filename, std::ios::out | std::ofstream::binary);
+    fout.write(uuid_delta_1_0_0.data(), uuid_delta_1_0_0.size());
+    const char padding[4] = {};
+    fout.write(padding, sizeof(padding));
+    const uint64_t header[] = {bits_.size(), numberOfHashFunctions_, delta_region, regions.size()};
+    fout.write(reinterpret_cast<const char*>(header), sizeof(header));
+    bitvector::block_type buffer[delta_region];
+    for (auto r : regions) {
+        uint64_t index = r;
+        auto first = r * delta_region;
+        auto last = std::min(first + delta_region, bits_.blocks_count());
+        // Other threads may still set bits in the region.
+        for (auto i = first; i < last; ++i)
+            buffer[i - first] = __atomic_load_n(bits_.blocks() + i, __ATOMIC_RELAXED);
+        fout.write(reinterpret_cast<const char*>(&index), sizeof(index));
+        fout.write(reinterpret_cast<const char*>(buffer), (last - first) * sizeof(bitvector::block_type));
+    }
+    fout.close();
+    if (!fout)
+        throw std::runtime_error("cannot write Bloom filter delta " + filename);
+}
+
+void basic_bloom_filter::apply_delta(std::string const& filename) {
+    std::ifstream fin(filename, std::ios::in | std::ifstream::binary);
+    std::string uuid(uuid_delta_1_0_0.size(), '\0');
+    fin.read(&uuid[0], uuid.size());
+    if (!fin || uuid != uuid_delta_1_0_0)
+        throw std::runtime_error("no Bloom filter delta in " + filename);
+    hidden_bf::skipChar(fin, 4);
+    uint64_t header[4];
+    fin.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!fin || header[0] != bits_.size() || header[1] != numberOfHashFunctions_ || header[2] != delta_region)
+        throw std::runtime_error("Bloom filter delta " + filename + " does not match the filter");
+    auto regions = (bits_.blocks_count() + delta_region - 1) / delta_region;
+    for (uint64_t i = 0; i < header[3]; ++i) {
+        uint64_t r;
+        fin.read(reinterpret_cast<char*>(&r), sizeof(r));
+        if (!fin || r >= regions)
+            throw std::runtime_error("corrupt Bloom filter delta " + filename);
+        auto first = r * delta_region;
+        auto last = std::min<size_t>(first + delta_region, bits_.blocks_count());
+        fin.read(reinterpret_cast<char*>(bits_.blocks() + first), (last - first) * sizeof(bitvector::block_type));
+    }
+    if (!fin)
+        throw std::runtime_error("truncated Bloom filter delta " + filename);
+}
+
+void basic_bloom_filter::writeHeader(std::ostream& fout, unsigned long long K, unsigned long long z,
+                                     bool canonical) const {
+    // write the UUID
+    fout.write(uuid_4_0_0.data(), uuid_4_0_0.size());
     // write k
     fout.write(reinterpret_cast<const char*>(&K), sizeof(K));
     // write z
     fout.write(reinterpret_cast<const char*>(&z), sizeof(z));
     // write canonical
     fout.write(reinterpret_cast<const char*>(&canonical), sizeof(canonical));
-    // TODO write the number of hash function
+    const char padding[hidden_bf::header_padding] = {};
+    fout.write(padding, sizeof(padding));
+    // write the number of hash functions
     fout.write(reinterpret_cast<const char*>(&numberOfHashFunctions_), sizeof(numberOfHashFunctions_));
-    // write the vector
-    std::vector<bool>::size_type n = bits_.size();
-    fout.write((const char*)&n, sizeof(std::vector<bool>::size_type));
-    for (std::vector<bool>::size_type i = 0; i < n;) {
-        unsigned char aggr = 0;
-        for (unsigned char mask = 1; mask > 0 && i < n; ++i, mask <<= 1)
-            if (bits_.at(i))
-                aggr |= mask;
-        fout.write((const char*)&aggr, sizeof(unsigned char));
-    }
-    fout.flush();
-    fout.close();
+    // write the parameters as (tag, value) pairs
+    const uint64_t parameters[][2] = {
+        {hidden_bf::tag_reduction, static_cast<uint64_t>(reduction_)},
+        {hidden_bf::tag_partition, partition_},
+        {hidden_bf::tag_hash_scheme, static_cast<uint64_t>(scheme_)},
+        {hidden_bf::tag_hash_family, static_cast<uint64_t>(family_)},
+        {hidden_bf::tag_seed, seed_},
+    };
+    uint64_t count = sizeof(parameters) / sizeof(parameters[0]);
+    fout.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    fout.write(reinterpret_cast<const char*>(parameters), sizeof(parameters));
 }
 
 void basic_bloom_filter::simpleSave(std::ofstream& fout) {
-    std::vector<bool>::size_type n = bits_.size();
-    fout.write((const char*)&n, sizeof(std::vector<bool>::size_type));
-    for (std::vector<bool>::size_type i = 0; i < n;) {
-        unsigned char aggr = 0;
-        for (unsigned char mask = 1; mask > 0 && i < n; ++i, mask <<= 1)
-            if (bits_.at(i))
-                aggr |= mask;
-        fout.write((const char*)&aggr, sizeof(unsigned char));
-    }
+    // The parameters are needed to reproduce the bit positions, e.g., of the
+    // default reduction::fastrange.
+    writeHeader(fout, 0, 0, false);
+    hidden_bf::writeBlocksToDisk(fout, bits_);
     fout.flush();
 }
 }  // namespace bf
@@ -0,0 +1,274 @@
+#include <bf/bloom_filter/binary_fuse.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include <bf/detail/mix.hpp>
+#include <bf/detail/parallel.hpp>
+#include <bf/wrap.hpp>
+
+namespace bf {
+namespace {
+
+using detail::mulhi;
+using detail::murmur64;
+
+constexpr size_t arity = 3;
+constexpr size_t max_attempts = 100;
+
+} // namespace
+
+template <typename Fingerprint>
+binary_fuse_filter<Fingerprint>::binary_fuse_filter(
+  std::vector<object> const& keys, size_t threads, size_t seed)
+    : hash_(default_hash_function(seed)), seed_(seed) {
+  std::vector<uint64_t> digests(keys.size());
+  detail::parallel_for(keys.size(), threads, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i)
+      digests[i] = hash_(keys[i]);
+  });
+  build(std::move(digests), threads);
+}
+
+template <typename Fingerprint>
+binary_fuse_filter<Fingerprint>::binary_fuse_filter(
+  std::vector<uint64_t> const& keys, size_t threads, size_t seed)
+    : hash_(default_hash_function(seed)), seed_(seed) {
+  std::vector<uint64_t> digests(keys.size());
+  detail::parallel_for(keys.size(), threads, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i)
+      digests[i] = hash_(wrap(keys[i]));
+  });
+  build(std::move(digests), threads);
+}
+
+template <typename Fingerprint>
+binary_fuse_filter<Fingerprint>::binary_fuse_filter(
+  std::string const& filename, unsigned long long& K, unsigned long long& z,
+  bool& canonical) {
+  std::ifstream fin(filename, std::ios::in | std::ifstream::binary);
+  if (!fin)
+    throw std::runtime_error("cannot open " + filename);
+  std::string uuid(uuid_1_0_0.size(), '\0');
+  fin.read(&uuid[0], uuid.size());
+  if (uuid != uuid_1_0_0)
+    throw std::runtime_error(filename
+                             + " does not contain a binary fuse filter");
+  size_t fingerprint_bits;
+  size_t slots;
+  fin.read(reinterpret_cast<char*>(&K), sizeof(K));
+  fin.read(reinterpret_cast<char*>(&z), sizeof(z));
+  fin.read(reinterpret_cast<char*>(&canonical), sizeof(canonical));
+  fin.read(reinterpret_cast<char*>(&fingerprint_bits),
+           sizeof(fingerprint_bits));
+  if (fingerprint_bits != sizeof(Fingerprint) * 8)
+    throw std::runtime_error(filename + " has fingerprints of a different "
+                                        "width");
+  fin.read(reinterpret_cast<char*>(&seed_), sizeof(seed_));
+  fin.read(reinterpret_cast<char*>(&fuse_seed_), sizeof(fuse_seed_));
+  fin.read(reinterpret_cast<char*>(&segment_length_),
+           sizeof(segment_length_));
+  fin.read(reinterpret_cast<char*>(&segment_count_length_),
+           sizeof(segment_count_length_));
+  fin.read(reinterpret_cast<char*>(&slots), sizeof(slots));
+  if (!fin)
+    throw std::runtime_error("truncated binary fuse filter in " + filename);
+  // The three positions of a key lie in consecutive segments starting
+  // below segment_count_length_.
+  if (segment_length_ == 0 || (segment_length_ & (segment_length_ - 1)) != 0
+      || segment_count_length_ % segment_length_ != 0
+      || segment_count_length_ > slots
+      || slots - segment_count_length_ < 2 * segment_length_)
+    throw std::runtime_error("invalid binary fuse filter dimensions in "
+                             + filename);
+  hash_ = default_hash_function(seed_);
+  fingerprints_.resize(slots);
+  fin.read(reinterpret_cast<char*>(fingerprints_.data()),
+           slots * sizeof(Fingerprint));
+  if (!fin)
+    throw std::runtime_error("truncated binary fuse filter in " + filename);
+}
+
+template <typename Fingerprint>
+void binary_fuse_filter<Fingerprint>::add(object const&) {
+  throw std::logic_error("cannot add to a static binary fuse filter");
+}
+
+template <typename Fingerprint>
+size_t binary_fuse_filter<Fingerprint>::lookup(object const& o) const {
+  return lookup_hash(murmur64(hash_(o) + fuse_seed_));
+}
+
+template <typename Fingerprint>
+size_t binary_fuse_filter<Fingerprint>::slots() const {
+  return fingerprints_.size();
+}
+
+template <typename Fingerprint>
+std::vector<Fingerprint> const&
+binary_fuse_filter<Fingerprint>::storage() const {
+  return fingerprints_;
+}
+
+template <typename Fingerprint>
+void binary_fuse_filter<Fingerprint>::save(std::string const& filename,
+                                           unsigned long long K,
+                                           unsigned long long z,
+                                           bool canonical) const {
+  std::ofstream fout(filename, std::ios::out | std::ofstream::binary);
+  size_t fingerprint_bits = sizeof(Fingerprint) * 8;
+  size_t slots = fingerprints_.size();
+  fout.write(uuid_1_0_0.data(), uuid_1_0_0.size());
+  fout.write(reinterpret_cast<const char*>(&K), sizeof(K));
+  fout.write(reinterpret_cast<const char*>(&z), sizeof(z));
+  fout.write(reinterpret_cast<const char*>(&canonical), sizeof(canonical));
+  fout.write(reinterpret_cast<const char*>(&fingerprint_bits),
+             sizeof(fingerprint_bits));
+  fout.write(reinterpret_cast<const char*>(&seed_), sizeof(seed_));
+  fout.write(reinterpret_cast<const char*>(&fuse_seed_), sizeof(fuse_seed_));
+  fout.write(reinterpret_cast<const char*>(&segment_length_),
+             sizeof(segment_length_));
+  fout.write(reinterpret_cast<const char*>(&segment_count_length_),
+             sizeof(segment_count_length_));
+  fout.write(reinterpret_cast<const char*>(&slots), sizeof(slots));
+  fout.write(reinterpret_cast<const char*>(fingerprints_.data()),
+             slots * sizeof(Fingerprint));
+  fout.flush();
+  fout.close();
+}
+
+template <typename Fingerprint>
+void binary_fuse_filter<Fingerprint>::build(std::vector<uint64_t> digests,
+                                            size_t threads) {
+  // Duplicate keys would make the construction fail.
+  detail::parallel_sort(digests, threads);
+  digests.erase(std::unique(digests.begin(), digests.end()), digests.end());
+  auto n = digests.size();
+  // Sizing parameters as recommended by Graf and Lemire.
+  segment_length_ = n == 0 ? 4
+                           : size_t(1) << static_cast<int>(std::floor(
+                               std::log(static_cast<double>(n))
+                                 / std::log(3.33)
+                               + 2.25));
+  segment_length_ = std::min(segment_length_, size_t(262144));
+  auto size_factor =
+    n <= 1 ? 0.0
+           : std::max(1.125, 0.875 + 0.25 * std::log(1000000.0)
+                                       / std::log(static_cast<double>(n)));
+  auto capacity = static_cast<size_t>(std::round(n * size_factor));
+  auto segment_count = (capacity + segment_length_ - 1) / segment_length_;
+  segment_count = segment_count <= arity - 1 ? 1 : segment_count - (arity - 1);
+  segment_count_length_ = segment_count * segment_length_;
+  fingerprints_.assign((segment_count + arity - 1) * segment_length_, 0);
+  // Each attempt remixes the key digests with a fresh seed; sorting the mixed
+  // hashes groups keys by segment, which keeps the peeling cache-friendly.
+  uint64_t state = 0x726b2b9d438b9d4dULL;
+  std::vector<uint64_t> hashes(n);
+  for (size_t attempt = 0; attempt < max_attempts; ++attempt) {
+    state += 0x9e3779b97f4a7c15ULL;
+    fuse_seed_ = murmur64(state);
+    detail::parallel_for(n, threads, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i)
+        hashes[i] = murmur64(digests[i] + fuse_seed_);
+    });
+    detail::parallel_sort(hashes, threads);
+    if (std::adjacent_find(hashes.begin(), hashes.end()) != hashes.end())
+      continue;
+    if (construct(hashes))
+      return;
+    std::fill(fingerprints_.begin(), fingerprints_.end(), 0);
+  }
+  throw std::runtime_error("failed to construct binary fuse filter");
+}
+
+template <typename Fingerprint>
+bool binary_fuse_filter<Fingerprint>::construct(std::vector<uint64_t>& hashes) {
+  auto n = hashes.size();
+  auto m = fingerprints_.size();
+  // For each slot, the number of keys mapping to it (upper six bits), the
+  // XOR of their position indexes (lower two bits), and the XOR of their
+  // hashes. A slot with a single key identifies that key.
+  std::vector<uint8_t> t2count(m, 0);
+  std::vector<uint64_t> t2hash(m, 0);
+  size_t h[arity];
+  for (auto hash : hashes) {
+    positions(hash, h);
+    for (size_t j = 0; j < arity; ++j) {
+      t2count[h[j]] += 4;
+      t2count[h[j]] ^= j;
+      t2hash[h[j]] ^= hash;
+      if (t2count[h[j]] < 4)
+        return false; // overflow
+    }
+  }
+  // Peel slots with a single key until every key is assigned to a slot.
+  std::vector<size_t> alone;
+  alone.reserve(m);
+  for (size_t i = 0; i < m; ++i)
+    if ((t2count[i] >> 2) == 1)
+      alone.push_back(i);
+  std::vector<uint64_t> order;
+  std::vector<uint8_t> order_slot;
+  order.reserve(n);
+  order_slot.reserve(n);
+  while (!alone.empty()) {
+    auto i = alone.back();
+    alone.pop_back();
+    if ((t2count[i] >> 2) != 1)
+      continue;
+    auto hash = t2hash[i];
+    size_t found = t2count[i] & 3;
+    order.push_back(hash);
+    order_slot.push_back(found);
+    positions(hash, h);
+    for (size_t j = 0; j < arity; ++j) {
+      if (j == found)
+        continue;
+      auto other = h[j];
+      t2count[other] -= 4;
+      t2count[other] ^= j;
+      t2hash[other] ^= hash;
+      if ((t2count[other] >> 2) == 1)
+        alone.push_back(other);
+    }
+  }
+  if (order.size() != n)
+    return false;
+  // Assign fingerprints in reverse peeling order, so that each key's slot is
+  // written after the other two slots of the key are final.
+  for (auto i = n; i-- > 0;) {
+    auto hash = order[i];
+    positions(hash, h);
+    auto fp = static_cast<Fingerprint>(hash ^ (hash >> 32));
+    for (size_t j = 0; j < arity; ++j)
+      if (j != order_slot[i])
+        fp ^= fingerprints_[h[j]];
+    fingerprints_[h[order_slot[i]]] = fp;
+  }
+  return true;
+}
+
+template <typename Fingerprint>
+void binary_fuse_filter<Fingerprint>::positions(uint64_t hash,
+                                                size_t* h) const {
+  auto mask = segment_length_ - 1;
+  h[0] = mulhi(hash, segment_count_length_);
+  h[1] = (h[0] + segment_length_) ^ ((hash >> 18) & mask);
+  h[2] = (h[0] + 2 * segment_length_) ^ (hash & mask);
+}
+
+template <typename Fingerprint>
+size_t binary_fuse_filter<Fingerprint>::lookup_hash(uint64_t hash) const {
+  size_t h[arity];
+  positions(hash, h);
+  auto fp = static_cast<Fingerprint>(hash ^ (hash >> 32));
+  fp ^= fingerprints_[h[0]] ^ fingerprints_[h[1]] ^ fingerprints_[h[2]];
+  return fp == 0;
+}
+
+template class binary_fuse_filter<uint8_t>;
+template class binary_fuse_filter<uint16_t>;
+
+} // namespace bf
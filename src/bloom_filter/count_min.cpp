@@ -0,0 +1,99 @@
+#include <bf/bloom_filter/count_min.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace bf {
+
+size_t count_min_sketch::w(double epsilon) {
+  return std::ceil(std::exp(1.0) / epsilon);
+}
+
+size_t count_min_sketch::d(double delta) {
+  return std::ceil(std::log(1.0 / delta));
+}
+
+count_min_sketch::count_min_sketch(size_t depth, size_t width,
+                                   bool conservative)
+    : hasher_(make_hasher(depth)),
+      depth_(depth),
+      width_(width),
+      conservative_(conservative),
+      cells_(depth * width) {
+  assert(width > 0);
+}
+
+void count_min_sketch::add(object const& o) {
+  auto const max = std::numeric_limits<counter_type>::max();
+  auto digests = hasher_(o);
+  assert(digests.size() == depth_);
+  if (!conservative_) {
+    for (size_t i = 0; i < depth_; ++i) {
+      auto& c = cells_[i * width_ + digests[i] % width_];
+      if (c < max)
+        ++c;
+    }
+    return;
+  }
+  // Conservative update: only raise the counters that hold the minimum.
+  for (size_t i = 0; i < depth_; ++i)
+    digests[i] = i * width_ + digests[i] % width_;
+  auto min = max;
+  for (auto p : digests)
+    min = std::min(min, cells_[p]);
+  if (min == max)
+    return;
+  for (auto p : digests)
+    if (cells_[p] == min)
+      cells_[p] = min + 1;
+}
+
+size_t count_min_sketch::lookup(object const& o) const {
+  auto digests = hasher_(o);
+  assert(digests.size() == depth_);
+  auto min = std::numeric_limits<counter_type>::max();
+  for (size_t i = 0; i < depth_; ++i)
+    min = std::min(min, cells_[i * width_ + digests[i] % width_]);
+  return min;
+}
+
+void count_min_sketch::clear() {
+  std::fill(cells_.begin(), cells_.end(), 0);
+}
+
+void count_min_sketch::merge(count_min_sketch const& other) {
+  if (depth_ != other.depth_ || width_ != other.width_)
+    throw std::invalid_argument("count-min sketch dimensions differ");
+  auto const max = std::numeric_limits<counter_type>::max();
+  for (size_t i = 0; i < cells_.size(); ++i) {
+    auto x = cells_[i];
+    auto y = other.cells_[i];
+    cells_[i] = x > max - y ? max : x + y;
+  }
+}
+
+size_t count_min_sketch::depth() const {
+  return depth_;
+}
+
+size_t count_min_sketch::width() const {
+  return width_;
+}
+
+bool count_min_sketch::conservative() const {
+  return conservative_;
+}
+
+std::vector<count_min_sketch::counter_type> const&
+count_min_sketch::storage() const {
+  return cells_;
+}
+
+hasher const& count_min_sketch::hasher_function() const {
+  return hasher_;
+}
+
+} // namespace bf
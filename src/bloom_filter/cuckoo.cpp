@@ -0,0 +1,277 @@
+#include <bf/bloom_filter/cuckoo.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace bf {
+
+constexpr size_t cuckoo_filter::bucket_size;
+constexpr size_t cuckoo_filter::max_kicks;
+
+cuckoo_filter::cuckoo_filter(size_t capacity, size_t fingerprint_bits,
+                             size_t seed)
+    : hash_(default_hash_function(seed)), seed_(seed) {
+  auto buckets = static_cast<size_t>(
+    std::ceil(static_cast<double>(capacity) / (bucket_size * 0.95)));
+  size_t n = 1;
+  while (n < buckets)
+    n <<= 1;
+  init(n, fingerprint_bits);
+}
+
+cuckoo_filter::cuckoo_filter(std::string const& filename,
+                             unsigned long long& K, unsigned long long& z,
+                             bool& canonical) {
+  std::ifstream fin(filename, std::ios::in | std::ifstream::binary);
+  if (!fin)
+    throw std::runtime_error("cannot open " + filename);
+  std::string uuid(uuid_1_0_0.size(), '\0');
+  fin.read(&uuid[0], uuid.size());
+  if (uuid != uuid_1_0_0)
+    throw std::runtime_error(filename + " does not contain a cuckoo filter");
+  size_t fingerprint_bits;
+  size_t buckets;
+  fin.read(reinterpret_cast<char*>(&K), sizeof(K));
+  fin.read(reinterpret_cast<char*>(&z), sizeof(z));
+  fin.read(reinterpret_cast<char*>(&canonical), sizeof(canonical));
+  fin.read(reinterpret_cast<char*>(&fingerprint_bits),
+           sizeof(fingerprint_bits));
+  fin.read(reinterpret_cast<char*>(&seed_), sizeof(seed_));
+  fin.read(reinterpret_cast<char*>(&buckets), sizeof(buckets));
+  if (!fin)
+    throw std::runtime_error("truncated cuckoo filter in " + filename);
+  // Bucket indexes are masked with the count, which must be a power of two.
+  if (buckets == 0 || (buckets & (buckets - 1)) != 0
+      || (fingerprint_bits != 8 && fingerprint_bits != 16))
+    throw std::runtime_error("invalid cuckoo filter dimensions in " + filename);
+  init(buckets, fingerprint_bits);
+  hash_ = default_hash_function(seed_);
+  fin.read(reinterpret_cast<char*>(&count_), sizeof(count_));
+  fin.read(reinterpret_cast<char*>(&victim_used_), sizeof(victim_used_));
+  fin.read(reinterpret_cast<char*>(&victim_bucket_), sizeof(victim_bucket_));
+  fin.read(reinterpret_cast<char*>(&victim_fingerprint_),
+           sizeof(victim_fingerprint_));
+  fin.read(reinterpret_cast<char*>(blocks_.data()),
+           blocks_.size() * sizeof(uint64_t));
+  if (!fin)
+    throw std::runtime_error("truncated cuckoo filter in " + filename);
+  if (victim_used_ && victim_bucket_ >= buckets_)
+    throw std::runtime_error("invalid cuckoo filter victim in " + filename);
+}
+
+void cuckoo_filter::init(size_t buckets, size_t fingerprint_bits) {
+  if (fingerprint_bits != 8 && fingerprint_bits != 16)
+    throw std::invalid_argument("fingerprints must have 8 or 16 bits");
+  assert(buckets > 0 && (buckets & (buckets - 1)) == 0);
+  fingerprint_bits_ = fingerprint_bits;
+  fingerprint_mask_ = (uint64_t(1) << fingerprint_bits) - 1;
+  auto bucket_bits = bucket_size * fingerprint_bits;
+  bucket_mask_ = bucket_bits == 64 ? ~uint64_t(0)
+                                   : (uint64_t(1) << bucket_bits) - 1;
+  lanes_low_ = 0;
+  for (size_t j = 0; j < bucket_size; ++j)
+    lanes_low_ |= uint64_t(1) << (j * fingerprint_bits);
+  lanes_high_ = lanes_low_ << (fingerprint_bits - 1);
+  buckets_ = buckets;
+  blocks_.assign((buckets * bucket_bits + 63) / 64, 0);
+}
+
+void cuckoo_filter::add(object const& o) {
+  if (!insert(o))
+    throw std::length_error("cuckoo filter is full");
+}
+
+size_t cuckoo_filter::lookup(object const& o) const {
+  auto p = locate(o);
+  if (contains(p.bucket, p.fingerprint)
+      || contains(alternate(p.bucket, p.fingerprint), p.fingerprint))
+    return 1;
+  return victim_used_ && victim_fingerprint_ == p.fingerprint
+             && (victim_bucket_ == p.bucket
+                 || victim_bucket_ == alternate(p.bucket, p.fingerprint));
+}
+
+bool cuckoo_filter::insert(object const& o) {
+  return insert(locate(o));
+}
+
+size_t cuckoo_filter::insert(object const* objects, size_t n) {
+  static constexpr size_t batch = 16;
+  position ps[batch];
+  for (size_t i = 0; i < n; i += batch) {
+    auto m = std::min(batch, n - i);
+    for (size_t j = 0; j < m; ++j) {
+      ps[j] = locate(objects[i + j]);
+      auto alt = alternate(ps[j].bucket, ps[j].fingerprint);
+      __builtin_prefetch(&blocks_[ps[j].bucket * bucket_size
+                                  * fingerprint_bits_ / 64]);
+      __builtin_prefetch(&blocks_[alt * bucket_size * fingerprint_bits_ / 64]);
+    }
+    for (size_t j = 0; j < m; ++j)
+      if (!insert(ps[j]))
+        return i + j;
+  }
+  return n;
+}
+
+bool cuckoo_filter::remove(object const& o) {
+  auto p = locate(o);
+  auto alt = alternate(p.bucket, p.fingerprint);
+  if (try_remove(p.bucket, p.fingerprint) || try_remove(alt, p.fingerprint)) {
+    --count_;
+    // A slot became free, so the victim may fit now.
+    if (victim_used_) {
+      victim_used_ = false;
+      --count_;
+      insert(position{victim_bucket_, victim_fingerprint_});
+    }
+    return true;
+  }
+  if (victim_used_ && victim_fingerprint_ == p.fingerprint
+      && (victim_bucket_ == p.bucket || victim_bucket_ == alt)) {
+    victim_used_ = false;
+    --count_;
+    return true;
+  }
+  return false;
+}
+
+void cuckoo_filter::clear() {
+  std::fill(blocks_.begin(), blocks_.end(), 0);
+  count_ = 0;
+  victim_used_ = false;
+}
+
+size_t cuckoo_filter::size() const {
+  return count_;
+}
+
+size_t cuckoo_filter::slots() const {
+  return buckets_ * bucket_size;
+}
+
+size_t cuckoo_filter::fingerprint_bits() const {
+  return fingerprint_bits_;
+}
+
+void cuckoo_filter::save(std::string const& filename, unsigned long long K,
+                         unsigned long long z, bool canonical) const {
+  std::ofstream fout(filename, std::ios::out | std::ofstream::binary);
+  fout.write(uuid_1_0_0.data(), uuid_1_0_0.size());
+  fout.write(reinterpret_cast<const char*>(&K), sizeof(K));
+  fout.write(reinterpret_cast<const char*>(&z), sizeof(z));
+  fout.write(reinterpret_cast<const char*>(&canonical), sizeof(canonical));
+  fout.write(reinterpret_cast<const char*>(&fingerprint_bits_),
+             sizeof(fingerprint_bits_));
+  fout.write(reinterpret_cast<const char*>(&seed_), sizeof(seed_));
+  fout.write(reinterpret_cast<const char*>(&buckets_), sizeof(buckets_));
+  fout.write(reinterpret_cast<const char*>(&count_), sizeof(count_));
+  fout.write(reinterpret_cast<const char*>(&victim_used_),
+             sizeof(victim_used_));
+  fout.write(reinterpret_cast<const char*>(&victim_bucket_),
+             sizeof(victim_bucket_));
+  fout.write(reinterpret_cast<const char*>(&victim_fingerprint_),
+             sizeof(victim_fingerprint_));
+  fout.write(reinterpret_cast<const char*>(blocks_.data()),
+             blocks_.size() * sizeof(uint64_t));
+  fout.flush();
+  fout.close();
+}
+
+cuckoo_filter::position cuckoo_filter::locate(object const& o) const {
+  auto d = static_cast<uint64_t>(hash_(o));
+  // The bucket comes from the low bits and the fingerprint from the high
+  // bits of the digest; a zero fingerprint marks an empty slot.
+  auto fp = (d >> 32) & fingerprint_mask_;
+  if (fp == 0)
+    fp = 1;
+  return {static_cast<size_t>(d & (buckets_ - 1)), fp};
+}
+
+size_t cuckoo_filter::alternate(size_t bucket, uint64_t fingerprint) const {
+  return (bucket ^ (fingerprint * 0x5bd1e995)) & (buckets_ - 1);
+}
+
+uint64_t cuckoo_filter::bucket(size_t i) const {
+  auto bit = i * bucket_size * fingerprint_bits_;
+  return (blocks_[bit / 64] >> (bit % 64)) & bucket_mask_;
+}
+
+uint64_t cuckoo_filter::slot(size_t i, size_t j) const {
+  return (bucket(i) >> (j * fingerprint_bits_)) & fingerprint_mask_;
+}
+
+void cuckoo_filter::slot(size_t i, size_t j, uint64_t fingerprint) {
+  auto bit = i * bucket_size * fingerprint_bits_ + j * fingerprint_bits_;
+  auto& block = blocks_[bit / 64];
+  block &= ~(fingerprint_mask_ << (bit % 64));
+  block |= fingerprint << (bit % 64);
+}
+
+bool cuckoo_filter::contains(size_t i, uint64_t fingerprint) const {
+  // Compare all lanes at once: a lane of x is zero iff it matches.
+  auto x = bucket(i) ^ (fingerprint * lanes_low_);
+  return ((x - lanes_low_) & ~x & lanes_high_) != 0;
+}
+
+bool cuckoo_filter::try_insert(size_t i, uint64_t fingerprint) {
+  for (size_t j = 0; j < bucket_size; ++j)
+    if (slot(i, j) == 0) {
+      slot(i, j, fingerprint);
+      return true;
+    }
+  return false;
+}
+
+bool cuckoo_filter::try_remove(size_t i, uint64_t fingerprint) {
+  for (size_t j = 0; j < bucket_size; ++j)
+    if (slot(i, j) == fingerprint) {
+      slot(i, j, 0);
+      return true;
+    }
+  return false;
+}
+
+bool cuckoo_filter::insert(position p) {
+  if (victim_used_)
+    return false;
+  auto i = p.bucket;
+  auto fp = p.fingerprint;
+  if (try_insert(i, fp) || try_insert(alternate(i, fp), fp)) {
+    ++count_;
+    return true;
+  }
+  if (next() & 1)
+    i = alternate(i, fp);
+  for (size_t n = 0; n < max_kicks; ++n) {
+    auto j = next() % bucket_size;
+    auto evicted = slot(i, j);
+    slot(i, j, fp);
+    fp = evicted;
+    i = alternate(i, fp);
+    if (try_insert(i, fp)) {
+      ++count_;
+      return true;
+    }
+  }
+  // Keep the last evicted fingerprint aside so that no element is lost; the
+  // filter accepts no further insertions until a slot is freed.
+  victim_used_ = true;
+  victim_bucket_ = i;
+  victim_fingerprint_ = fp;
+  ++count_;
+  return true;
+}
+
+uint64_t cuckoo_filter::next() {
+  // xorshift64*
+  state_ ^= state_ >> 12;
+  state_ ^= state_ << 25;
+  state_ ^= state_ >> 27;
+  return state_ * 0x2545f4914f6cdd1dULL;
+}
+
+} // namespace bf
@@ -0,0 +1,46 @@
+#include <bf/bloom_filter/numa.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <bf/storage.hpp>
+
+namespace bf {
+
+numa_bloom_filter::numa_bloom_filter(basic_bloom_filter const& filter,
+                                     placement p) {
+  auto nodes = numa_nodes();
+  routes_.assign(*std::max_element(nodes.begin(), nodes.end()) + 1, 0);
+  if (p == placement::interleave || nodes.size() == 1) {
+    auto allocator = std::make_shared<numa_allocator>(
+      nodes, p == placement::interleave);
+    copies_.emplace_back(new basic_bloom_filter(filter, allocator));
+    return;
+  }
+  // The pages of each replica are placed by policy on first touch, which
+  // happens while the bits are copied.
+  for (auto node : nodes) {
+    auto allocator = std::make_shared<numa_allocator>(
+      std::vector<size_t>{node});
+    routes_[node] = copies_.size();
+    copies_.emplace_back(new basic_bloom_filter(filter, allocator));
+  }
+}
+
+void numa_bloom_filter::add(object const&) {
+  throw std::logic_error("cannot add to a read-only NUMA filter");
+}
+
+size_t numa_bloom_filter::lookup(object const& o) const {
+  return replica(current_numa_node()).lookup(o);
+}
+
+size_t numa_bloom_filter::replicas() const {
+  return copies_.size();
+}
+
+basic_bloom_filter const& numa_bloom_filter::replica(size_t node) const {
+  return *copies_[node < routes_.size() ? routes_[node] : 0];
+}
+
+} // namespace bf
@@ -0,0 +1,254 @@
+#include <bf/bloom_filter/paged.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bf {
+
+constexpr size_t paged_bloom_filter::default_page_size;
+constexpr size_t paged_bloom_filter::batch_size;
+
+namespace {
+
+size_t checked_page_size(size_t page_size) {
+  if (page_size == 0 || page_size % sizeof(bitvector::block_type) != 0)
+    throw std::invalid_argument("page size must be a positive multiple of 8");
+  return page_size;
+}
+
+} // namespace
+
+paged_bloom_filter::paged_bloom_filter(std::string const& filename,
+                                       size_t budget, size_t page_size,
+                                       bool writable)
+    : shell_(hasher_config(), bitvector(), false, reduction::modulo),
+      writable_(writable),
+      page_size_(checked_page_size(page_size)),
+      capacity_(std::max(size_t(1), budget / page_size)) {
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  if (!in)
+    throw std::runtime_error("cannot open Bloom filter " + filename);
+  std::string uuid(shell_.uuid_4_0_0.size(), '\0');
+  in.read(&uuid[0], uuid.size());
+  if (!in || uuid != shell_.uuid_4_0_0)
+    throw std::runtime_error("no current Bloom filter in " + filename);
+  unsigned long long K, z;
+  bool canonical;
+  shell_.readHeader(in, K, z, canonical, filename);
+  uint64_t n = 0;
+  in.read(reinterpret_cast<char*>(&n), sizeof(n));
+  if (!in)
+    throw std::runtime_error("truncated Bloom filter in " + filename);
+  offset_ = static_cast<uint64_t>(in.tellg());
+  shell_.adopt(bitvector(nullptr, n), filename);
+  open(filename, writable);
+}
+
+paged_bloom_filter::paged_bloom_filter(std::string const& filename,
+                                       hasher_config const& config,
+                                       size_t cells, size_t budget,
+                                       size_t page_size, bool partition,
+                                       reduction r)
+    : shell_(config,
+             bitvector(nullptr, basic_bloom_filter::rounded_cells(
+                                  config.k, cells, partition, r)),
+             partition, r),
+      writable_(true),
+      page_size_(checked_page_size(page_size)),
+      capacity_(std::max(size_t(1), budget / page_size)) {
+  std::ofstream out(filename,
+                    std::ios::out | std::ios::binary | std::ios::trunc);
+  shell_.writeHeader(out, 0, 0, false);
+  uint64_t n = shell_.bits_.size();
+  out.write(reinterpret_cast<char const*>(&n), sizeof(n));
+  offset_ = static_cast<uint64_t>(out.tellp());
+  out.close();
+  // The bits are a hole in the file, which reads as zero.
+  auto size = offset_ + shell_.bits_.blocks_count() * sizeof(bitvector::block_type);
+  if (!out || truncate(filename.c_str(), static_cast<off_t>(size)) != 0)
+    throw std::runtime_error("cannot create Bloom filter " + filename);
+  open(filename, true);
+}
+
+paged_bloom_filter::~paged_bloom_filter() {
+  try {
+    flush();
+  } catch (...) {
+  }
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+void paged_bloom_filter::open(std::string const& filename, bool writable) {
+  fd_ = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+  if (fd_ < 0)
+    throw std::runtime_error("cannot open Bloom filter " + filename);
+  auto size = offset_
+              + shell_.bits_.blocks_count() * sizeof(bitvector::block_type);
+  struct stat st;
+  if (fstat(fd_, &st) != 0 || static_cast<uint64_t>(st.st_size) < size) {
+    close(fd_);
+    fd_ = -1;
+    throw std::runtime_error("truncated Bloom filter in " + filename);
+  }
+}
+
+void paged_bloom_filter::add(object const& o) {
+  if (!writable_)
+    throw std::logic_error("cannot add to a read-only paged filter");
+  auto digests = shell_.hasher_(o);
+  for (size_t i = 0; i < digests.size(); ++i)
+    set(shell_.position(i, digests[i]));
+}
+
+size_t paged_bloom_filter::lookup(object const& o) const {
+  auto digests = shell_.hasher_(o);
+  for (size_t i = 0; i < digests.size(); ++i)
+    if (!test(shell_.position(i, digests[i])))
+      return 0;
+  return 1;
+}
+
+void paged_bloom_filter::add(object const* objects, size_t n) {
+  if (!writable_)
+    throw std::logic_error("cannot add to a read-only paged filter");
+  std::vector<std::pair<size_t, size_t>> cells;
+  for (size_t first = 0; first < n; first += batch_size) {
+    probes(objects + first, std::min(batch_size, n - first), cells);
+    for (auto& c : cells)
+      set(c.first);
+  }
+}
+
+void paged_bloom_filter::lookup(object const* objects, size_t n,
+                                size_t* results) const {
+  std::vector<std::pair<size_t, size_t>> cells;
+  for (size_t first = 0; first < n; first += batch_size) {
+    auto count = std::min(batch_size, n - first);
+    std::fill(results + first, results + first + count, 1);
+    probes(objects + first, count, cells);
+    for (auto& c : cells) {
+      auto& result = results[first + c.second];
+      if (result && !test(c.first))
+        result = 0;
+    }
+  }
+}
+
+void paged_bloom_filter::probes(
+  object const* objects, size_t n,
+  std::vector<std::pair<size_t, size_t>>& out) const {
+  auto k = shell_.numberOfHashFunctions_;
+  std::vector<digest> digests(n * k);
+  shell_.batch_(objects, n, digests.data());
+  out.resize(n * k);
+  for (size_t i = 0; i < n * k; ++i)
+    out[i] = {shell_.position(i % k, digests[i]), i / k};
+  // Probes in cell order visit each page once.
+  std::sort(out.begin(), out.end());
+}
+
+void paged_bloom_filter::flush() {
+  for (auto& p : pages_) {
+    if (p.second.dirty) {
+      write(p.first, p.second);
+      p.second.dirty = false;
+    }
+  }
+}
+
+hasher_config paged_bloom_filter::configuration() const {
+  return shell_.configuration();
+}
+
+size_t paged_bloom_filter::cells() const {
+  return shell_.bits_.size();
+}
+
+size_t paged_bloom_filter::page_size() const {
+  return page_size_;
+}
+
+size_t paged_bloom_filter::page_capacity() const {
+  return capacity_;
+}
+
+size_t paged_bloom_filter::cached_pages() const {
+  return pages_.size();
+}
+
+size_t paged_bloom_filter::page_loads() const {
+  return loads_;
+}
+
+paged_bloom_filter::page& paged_bloom_filter::fetch(size_t index) const {
+  auto i = pages_.find(index);
+  if (i != pages_.end()) {
+    lru_.splice(lru_.begin(), lru_, i->second.position);
+    return i->second;
+  }
+  if (pages_.size() >= capacity_) {
+    auto victim = pages_.find(lru_.back());
+    if (victim->second.dirty)
+      write(victim->first, victim->second);
+    pages_.erase(victim);
+    lru_.pop_back();
+  }
+  auto per_page = page_size_ / sizeof(bitvector::block_type);
+  auto first = index * per_page;
+  auto count = std::min(per_page, shell_.bits_.blocks_count() - first);
+  page p;
+  p.blocks.resize(count);
+  auto bytes = count * sizeof(bitvector::block_type);
+  auto where = static_cast<off_t>(offset_ + first * sizeof(bitvector::block_type));
+  for (size_t done = 0; done < bytes;) {
+    auto r = pread(fd_, reinterpret_cast<char*>(p.blocks.data()) + done,
+                   bytes - done, where + static_cast<off_t>(done));
+    if (r <= 0)
+      throw std::runtime_error("cannot read Bloom filter page "
+                               + std::to_string(index));
+    done += static_cast<size_t>(r);
+  }
+  ++loads_;
+  lru_.push_front(index);
+  p.position = lru_.begin();
+  return pages_.emplace(index, std::move(p)).first->second;
+}
+
+void paged_bloom_filter::write(size_t index, page const& p) const {
+  auto first = index * (page_size_ / sizeof(bitvector::block_type));
+  auto bytes = p.blocks.size() * sizeof(bitvector::block_type);
+  auto where = static_cast<off_t>(offset_ + first * sizeof(bitvector::block_type));
+  for (size_t done = 0; done < bytes;) {
+    auto r = pwrite(fd_, reinterpret_cast<char const*>(p.blocks.data()) + done,
+                    bytes - done, where + static_cast<off_t>(done));
+    if (r <= 0)
+      throw std::runtime_error("cannot write Bloom filter page "
+                               + std::to_string(index));
+    done += static_cast<size_t>(r);
+  }
+}
+
+bool paged_bloom_filter::test(size_t cell) const {
+  auto bits = bitvector::bits_per_block;
+  auto per_page = page_size_ / sizeof(bitvector::block_type);
+  auto block = cell / bits;
+  auto& p = fetch(block / per_page);
+  return (p.blocks[block % per_page] >> (cell % bits)) & 1;
+}
+
+void paged_bloom_filter::set(size_t cell) {
+  auto bits = bitvector::bits_per_block;
+  auto per_page = page_size_ / sizeof(bitvector::block_type);
+  auto block = cell / bits;
+  auto& p = fetch(block / per_page);
+  p.blocks[block % per_page] |= bitvector::block_type(1) << (cell % bits);
+  p.dirty = true;
+}
+
+} // namespace bf
@@ -0,0 +1,406 @@
+#include <bf/bloom_filter/quotient.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <bf/detail/mix.hpp>
+
+namespace bf {
+namespace {
+
+uint64_t low_mask(size_t bits) {
+  return bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+}
+
+// Returns the position of the set bit of a given rank (0-based).
+size_t select64(uint64_t x, size_t rank) {
+  for (size_t i = 0; i < rank; ++i)
+    x &= x - 1;
+  return __builtin_ctzll(x);
+}
+
+} // namespace
+
+class quotient_filter::cursor {
+public:
+  explicit cursor(quotient_filter const& qf) : qf_(qf) {
+    seek(0);
+  }
+
+  bool done() const {
+    return quotient_ >= qf_.slots();
+  }
+
+  uint64_t quotient() const {
+    return quotient_;
+  }
+
+  uint64_t remainder() const {
+    return qf_.remainder(slot_);
+  }
+
+  uint64_t fingerprint() const {
+    return (quotient_ << qf_.remainder_bits_) | remainder();
+  }
+
+  void next() {
+    if (slot_ < end_)
+      ++slot_;
+    else
+      seek(quotient_ + 1);
+  }
+
+private:
+  // Moves to the run of the first occupied quotient from *q* on, which
+  // starts after the previous run.
+  void seek(uint64_t q) {
+    while (q < qf_.slots()) {
+      auto word = qf_.block(q)[1] >> (q % slots_per_block);
+      if (word != 0) {
+        q += __builtin_ctzll(word);
+        break;
+      }
+      q += slots_per_block - q % slots_per_block;
+    }
+    quotient_ = q;
+    if (done())
+      return;
+    slot_ = std::max(int64_t(q), end_ + 1);
+    end_ = qf_.select_run_end(slot_, 1);
+  }
+
+  quotient_filter const& qf_;
+  uint64_t quotient_ = 0;
+  int64_t slot_ = 0;
+  int64_t end_ = -1;
+};
+
+constexpr size_t quotient_filter::slots_per_block;
+constexpr size_t quotient_filter::header_words;
+constexpr double quotient_filter::max_load;
+
+quotient_filter::quotient_filter(size_t quotient_bits, size_t remainder_bits,
+                                 size_t seed)
+    : hash_(default_hash_function(seed)), seed_(seed) {
+  init(quotient_bits, remainder_bits);
+}
+
+void quotient_filter::init(size_t quotient_bits, size_t remainder_bits) {
+  if (remainder_bits == 0 || remainder_bits > 56
+      || quotient_bits + remainder_bits > 64)
+    throw std::invalid_argument("invalid quotient filter dimensions");
+  quotient_bits_ = quotient_bits;
+  remainder_bits_ = remainder_bits;
+  remainder_mask_ = low_mask(remainder_bits);
+  // One spare block absorbs runs that spill past the last home slot; more
+  // are appended on demand.
+  auto blocks = (slots() + slots_per_block - 1) / slots_per_block + 1;
+  total_slots_ = blocks * slots_per_block;
+  blocks_.assign(blocks * (header_words + remainder_bits), 0);
+  count_ = 0;
+}
+
+void quotient_filter::add(object const& o) {
+  auto fp = fingerprint(o);
+  while (!insert(fp >> remainder_bits_, fp & remainder_mask_))
+    resize();
+}
+
+size_t quotient_filter::lookup(object const& o) const {
+  auto fp = fingerprint(o);
+  auto q = fp >> remainder_bits_;
+  auto rem = fp & remainder_mask_;
+  if (!occupied(q))
+    return 0;
+  auto start = q == 0 ? int64_t(0) : std::max(int64_t(q), run_end(q - 1) + 1);
+  auto end = run_end(q);
+  size_t n = 0;
+  for (auto s = start; s <= end; ++s) {
+    auto x = remainder(s);
+    if (x > rem)
+      break;
+    n += x == rem;
+  }
+  return n;
+}
+
+bool quotient_filter::remove(object const& o) {
+  auto fp = fingerprint(o);
+  auto q = fp >> remainder_bits_;
+  auto rem = fp & remainder_mask_;
+  if (!occupied(q))
+    return false;
+  auto start = q == 0 ? int64_t(0) : std::max(int64_t(q), run_end(q - 1) + 1);
+  auto end = run_end(q);
+  auto pos = start;
+  while (pos <= end && remainder(pos) < rem)
+    ++pos;
+  if (pos > end || remainder(pos) != rem)
+    return false;
+  // Find the last slot that has to move left: subsequent runs move along as
+  // long as they were pushed away from their home slot.
+  auto last = end;
+  auto cur = q;
+  for (;;) {
+    auto next = last + 1;
+    if (next >= static_cast<int64_t>(total_slots_))
+      break;
+    auto q_next = cur + 1;
+    while (q_next < slots() && !occupied(q_next))
+      ++q_next;
+    if (q_next >= slots() || static_cast<int64_t>(q_next) >= next)
+      break;
+    last = select_run_end(next, 1);
+    cur = q_next;
+  }
+  for (auto s = pos; s < last; ++s) {
+    remainder(s, remainder(s + 1));
+    is_run_end(s, is_run_end(s + 1));
+  }
+  remainder(last, 0);
+  is_run_end(last, false);
+  if (start == end)
+    occupied(q, false);
+  else if (pos == end)
+    is_run_end(pos - 1, true);
+  --count_;
+  rebuild_offsets(q / slots_per_block + 1, last / slots_per_block);
+  return true;
+}
+
+void quotient_filter::resize() {
+  if (remainder_bits_ <= 1)
+    throw std::length_error("quotient filter cannot grow any further");
+  quotient_filter bigger(quotient_bits_ + 1, remainder_bits_ - 1, seed_);
+  int64_t last_end = -1;
+  uint64_t last_quotient = 0;
+  auto r = remainder_bits_ - 1;
+  for (cursor c(*this); !c.done(); c.next()) {
+    auto rem = c.remainder();
+    bigger.append((c.quotient() << 1) | (rem >> r), rem & low_mask(r),
+                  last_end, last_quotient);
+  }
+  bigger.rebuild_offsets(1, bigger.total_slots_ / slots_per_block - 1);
+  take(bigger);
+}
+
+void quotient_filter::merge(quotient_filter const& other) {
+  auto bits = quotient_bits_ + remainder_bits_;
+  if (other.quotient_bits_ + other.remainder_bits_ != bits
+      || other.seed_ != seed_)
+    throw std::invalid_argument("incompatible quotient filters");
+  auto total = count_ + other.count_;
+  auto q = std::max(quotient_bits_, other.quotient_bits_);
+  while (total > max_load * (uint64_t(1) << q))
+    ++q;
+  if (q >= bits)
+    throw std::length_error("merged quotient filter is too large");
+  // Both filters enumerate their fingerprints in sorted order, so merging
+  // the two streams is linear.
+  quotient_filter merged(q, bits - q, seed_);
+  int64_t last_end = -1;
+  uint64_t last_quotient = 0;
+  auto r = merged.remainder_bits_;
+  cursor x(*this);
+  cursor y(other);
+  while (!x.done() || !y.done()) {
+    auto& c = y.done() || (!x.done() && x.fingerprint() <= y.fingerprint())
+                ? x : y;
+    auto fp = c.fingerprint();
+    merged.append(fp >> r, fp & merged.remainder_mask_, last_end,
+                  last_quotient);
+    c.next();
+  }
+  merged.rebuild_offsets(1, merged.total_slots_ / slots_per_block - 1);
+  take(merged);
+}
+
+void quotient_filter::clear() {
+  std::fill(blocks_.begin(), blocks_.end(), 0);
+  count_ = 0;
+}
+
+size_t quotient_filter::size() const {
+  return count_;
+}
+
+size_t quotient_filter::slots() const {
+  return size_t(1) << quotient_bits_;
+}
+
+size_t quotient_filter::quotient_bits() const {
+  return quotient_bits_;
+}
+
+size_t quotient_filter::remainder_bits() const {
+  return remainder_bits_;
+}
+
+uint64_t quotient_filter::fingerprint(object const& o) const {
+  return detail::murmur64(hash_(o))
+         & low_mask(quotient_bits_ + remainder_bits_);
+}
+
+bool quotient_filter::insert(uint64_t q, uint64_t rem) {
+  if (count_ + 1 > max_load * slots())
+    return false;
+  auto start = q == 0 ? int64_t(0) : std::max(int64_t(q), run_end(q - 1) + 1);
+  auto new_run = !occupied(q);
+  auto end = new_run ? start - 1 : run_end(q);
+  // Keep the run sorted; equal remainders go after existing ones.
+  auto pos = start;
+  while (pos <= end && remainder(pos) <= rem)
+    ++pos;
+  auto e = find_unused(pos);
+  if (e == total_slots_) {
+    total_slots_ += slots_per_block;
+    blocks_.resize(blocks_.size() + header_words + remainder_bits_, 0);
+  }
+  for (auto s = e; static_cast<int64_t>(s) > pos; --s) {
+    remainder(s, remainder(s - 1));
+    is_run_end(s, is_run_end(s - 1));
+  }
+  remainder(pos, rem);
+  if (new_run) {
+    occupied(q, true);
+    is_run_end(pos, true);
+  } else if (pos == end + 1) {
+    is_run_end(end, false);
+    is_run_end(pos, true);
+  } else {
+    is_run_end(pos, false);
+  }
+  ++count_;
+  rebuild_offsets(q / slots_per_block + 1, e / slots_per_block);
+  return true;
+}
+
+void quotient_filter::append(uint64_t q, uint64_t rem, int64_t& last_end,
+                             uint64_t& last_quotient) {
+  int64_t pos;
+  if (last_end >= 0 && q == last_quotient) {
+    is_run_end(last_end, false);
+    pos = last_end + 1;
+  } else {
+    occupied(q, true);
+    pos = std::max(int64_t(q), last_end + 1);
+  }
+  if (pos >= static_cast<int64_t>(total_slots_)) {
+    total_slots_ += slots_per_block;
+    blocks_.resize(blocks_.size() + header_words + remainder_bits_, 0);
+  }
+  remainder(pos, rem);
+  is_run_end(pos, true);
+  last_end = pos;
+  last_quotient = q;
+  ++count_;
+}
+
+void quotient_filter::take(quotient_filter& other) {
+  quotient_bits_ = other.quotient_bits_;
+  remainder_bits_ = other.remainder_bits_;
+  remainder_mask_ = other.remainder_mask_;
+  total_slots_ = other.total_slots_;
+  count_ = other.count_;
+  blocks_.swap(other.blocks_);
+}
+
+void quotient_filter::rebuild_offsets(size_t first, size_t last) {
+  auto blocks = total_slots_ / slots_per_block;
+  for (auto b = std::max(first, size_t(1)); b <= last && b < blocks; ++b) {
+    auto base = b * slots_per_block;
+    auto end = run_end(base - 1);
+    block(base)[0] = end + 1 > static_cast<int64_t>(base) ? end + 1 - base : 0;
+  }
+}
+
+int64_t quotient_filter::run_end(uint64_t q) const {
+  auto b = block(q);
+  auto base = q - q % slots_per_block;
+  auto first = base + b[0];
+  auto d = __builtin_popcountll(b[1] & low_mask(q % slots_per_block + 1));
+  if (d == 0)
+    return static_cast<int64_t>(first) - 1;
+  return select_run_end(first, d);
+}
+
+int64_t quotient_filter::select_run_end(size_t from, size_t rank) const {
+  auto i = from / slots_per_block;
+  auto blocks = total_slots_ / slots_per_block;
+  auto word = block(from)[2] & (~uint64_t(0) << (from % slots_per_block));
+  for (;;) {
+    size_t n = __builtin_popcountll(word);
+    if (rank <= n)
+      return i * slots_per_block + select64(word, rank - 1);
+    rank -= n;
+    if (++i == blocks)
+      return total_slots_;
+    word = block(i * slots_per_block)[2];
+  }
+}
+
+size_t quotient_filter::find_unused(size_t from) const {
+  while (from < total_slots_) {
+    auto end = run_end(from);
+    if (end < static_cast<int64_t>(from))
+      return from;
+    from = end + 1;
+  }
+  return total_slots_;
+}
+
+uint64_t* quotient_filter::block(size_t slot) {
+  auto stride = header_words + remainder_bits_;
+  return &blocks_[slot / slots_per_block * stride];
+}
+
+uint64_t const* quotient_filter::block(size_t slot) const {
+  auto stride = header_words + remainder_bits_;
+  return &blocks_[slot / slots_per_block * stride];
+}
+
+bool quotient_filter::occupied(size_t slot) const {
+  return (block(slot)[1] >> (slot % slots_per_block)) & 1;
+}
+
+void quotient_filter::occupied(size_t slot, bool value) {
+  auto mask = uint64_t(1) << (slot % slots_per_block);
+  auto& word = block(slot)[1];
+  word = value ? word | mask : word & ~mask;
+}
+
+bool quotient_filter::is_run_end(size_t slot) const {
+  return (block(slot)[2] >> (slot % slots_per_block)) & 1;
+}
+
+void quotient_filter::is_run_end(size_t slot, bool value) {
+  auto mask = uint64_t(1) << (slot % slots_per_block);
+  auto& word = block(slot)[2];
+  word = value ? word | mask : word & ~mask;
+}
+
+uint64_t quotient_filter::remainder(size_t slot) const {
+  auto words = block(slot) + header_words;
+  auto bit = slot % slots_per_block * remainder_bits_;
+  auto offset = bit % 64;
+  auto x = words[bit / 64] >> offset;
+  if (offset + remainder_bits_ > 64)
+    x |= words[bit / 64 + 1] << (64 - offset);
+  return x & remainder_mask_;
+}
+
+void quotient_filter::remainder(size_t slot, uint64_t value) {
+  auto words = block(slot) + header_words;
+  auto bit = slot % slots_per_block * remainder_bits_;
+  auto offset = bit % 64;
+  auto& lo = words[bit / 64];
+  lo = (lo & ~(remainder_mask_ << offset)) | (value << offset);
+  if (offset + remainder_bits_ > 64) {
+    auto& hi = words[bit / 64 + 1];
+    auto shift = 64 - offset;
+    hi = (hi & ~(remainder_mask_ >> shift)) | (value >> shift);
+  }
+}
+
+} // namespace bf
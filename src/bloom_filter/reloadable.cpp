@@ -0,0 +1,104 @@
+#include <bf/bloom_filter/reloadable.hpp>
+
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+namespace bf {
+
+constexpr size_t reloadable_bloom_filter::stripes;
+
+namespace {
+
+std::unique_ptr<basic_bloom_filter> load(std::string const& filename) {
+  // The loading constructor exits the process on a missing file.
+  if (!std::ifstream(filename))
+    throw std::runtime_error("cannot open Bloom filter " + filename);
+  bool has_parameters;
+  unsigned long long K, z;
+  bool canonical;
+  return std::unique_ptr<basic_bloom_filter>(
+    new basic_bloom_filter(filename, has_parameters, K, z, canonical));
+}
+
+} // namespace
+
+reloadable_bloom_filter::guard::guard(reloadable_bloom_filter const& holder) {
+  auto i = stripe_index();
+  // A reader registers under the epoch it observed and proceeds only if the
+  // epoch did not move meanwhile. A publisher advances the epoch after
+  // swapping the filter, so a reader that registered in time may hold the
+  // old filter, and the publisher waits for its counter to drain; a reader
+  // that did not is guaranteed to load the new filter.
+  for (;;) {
+    auto e = holder.epoch_.load();
+    counter = &holder.counters_[e & 1][i].readers;
+    counter->fetch_add(1);
+    if (holder.epoch_.load() == e)
+      break;
+    counter->fetch_sub(1);
+  }
+  filter = holder.current_.load();
+}
+
+reloadable_bloom_filter::guard::~guard() {
+  counter->fetch_sub(1, std::memory_order_release);
+}
+
+size_t reloadable_bloom_filter::stripe_index() {
+  static thread_local size_t index
+    = std::hash<std::thread::id>()(std::this_thread::get_id()) % stripes;
+  return index;
+}
+
+reloadable_bloom_filter::reloadable_bloom_filter(
+  std::unique_ptr<basic_bloom_filter> filter)
+    : current_(filter.release()) {
+}
+
+reloadable_bloom_filter::reloadable_bloom_filter(std::string const& filename)
+    : reloadable_bloom_filter(load(filename)) {
+}
+
+reloadable_bloom_filter::~reloadable_bloom_filter() {
+  delete current_.load();
+}
+
+void reloadable_bloom_filter::add(object const&) {
+  throw std::logic_error("cannot add to a reloadable filter");
+}
+
+size_t reloadable_bloom_filter::lookup(object const& o) const {
+  guard g(*this);
+  return g.filter->lookup(o);
+}
+
+void reloadable_bloom_filter::lookup(object const* objects, size_t n,
+                                     size_t* results) const {
+  guard g(*this);
+  g.filter->lookup(objects, n, results);
+}
+
+void reloadable_bloom_filter::publish(
+  std::unique_ptr<basic_bloom_filter> filter) {
+  std::lock_guard<std::mutex> lock(publish_);
+  std::unique_ptr<basic_bloom_filter> old(current_.exchange(filter.release()));
+  // Readers of the old filter registered under the current epoch.
+  auto e = epoch_.fetch_add(1);
+  for (auto& s : counters_[e & 1])
+    while (s.readers.load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
+}
+
+std::future<void> reloadable_bloom_filter::reload(std::string filename) {
+  return std::async(std::launch::async, [this, filename] {
+    publish(load(filename));
+  });
+}
+
+uint64_t reloadable_bloom_filter::generation() const {
+  return epoch_.load();
+}
+
+} // namespace bf
@@ -0,0 +1,249 @@
+#include <bf/bloom_filter/ribbon.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include <bf/detail/mix.hpp>
+#include <bf/detail/parallel.hpp>
+#include <bf/wrap.hpp>
+
+namespace bf {
+namespace {
+
+using detail::mulhi;
+using detail::murmur64;
+
+constexpr size_t band_width = 64;
+
+// Keys per shard below which sharding only adds overhead.
+constexpr size_t min_shard_size = 65536;
+
+// Initial space overhead of the solution over the number of keys. A failed
+// shard retries with 2% more rows.
+constexpr double overhead = 1.06;
+
+size_t start(uint64_t start_hash, size_t blocks) {
+  return mulhi(start_hash, blocks * band_width - band_width + 1);
+}
+
+} // namespace
+
+ribbon_filter::ribbon_filter(std::vector<object> const& keys,
+                             size_t result_bits, size_t threads, size_t seed)
+    : hash_(default_hash_function(seed)),
+      seed_(seed),
+      result_bits_(result_bits) {
+  std::vector<digest> digests(keys.size());
+  detail::parallel_for(keys.size(), threads, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i)
+      digests[i] = hash_(keys[i]);
+  });
+  build(digests, threads);
+}
+
+ribbon_filter::ribbon_filter(std::vector<uint64_t> const& keys,
+                             size_t result_bits, size_t threads, size_t seed)
+    : hash_(default_hash_function(seed)),
+      seed_(seed),
+      result_bits_(result_bits) {
+  std::vector<digest> digests(keys.size());
+  detail::parallel_for(keys.size(), threads, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i)
+      digests[i] = hash_(wrap(keys[i]));
+  });
+  build(digests, threads);
+}
+
+ribbon_filter::ribbon_filter(std::string const& filename,
+                             unsigned long long& K, unsigned long long& z,
+                             bool& canonical) {
+  std::ifstream fin(filename, std::ios::in | std::ifstream::binary);
+  if (!fin)
+    throw std::runtime_error("cannot open " + filename);
+  std::string uuid(uuid_1_0_0.size(), '\0');
+  fin.read(&uuid[0], uuid.size());
+  if (uuid != uuid_1_0_0)
+    throw std::runtime_error(filename + " does not contain a Ribbon filter");
+  size_t shards;
+  fin.read(reinterpret_cast<char*>(&K), sizeof(K));
+  fin.read(reinterpret_cast<char*>(&z), sizeof(z));
+  fin.read(reinterpret_cast<char*>(&canonical), sizeof(canonical));
+  fin.read(reinterpret_cast<char*>(&result_bits_), sizeof(result_bits_));
+  fin.read(reinterpret_cast<char*>(&seed_), sizeof(seed_));
+  fin.read(reinterpret_cast<char*>(&shards), sizeof(shards));
+  if (!fin || result_bits_ == 0 || result_bits_ > 16 || shards == 0)
+    throw std::runtime_error("invalid Ribbon filter header in " + filename);
+  shard_offsets_.resize(shards + 1);
+  fin.read(reinterpret_cast<char*>(shard_offsets_.data()),
+           shard_offsets_.size() * sizeof(size_t));
+  if (!fin)
+    throw std::runtime_error("truncated Ribbon filter in " + filename);
+  // Every shard spans at least one block, and the last offset is the size
+  // of the solution.
+  if (shard_offsets_[0] != 0)
+    throw std::runtime_error("invalid Ribbon filter shards in " + filename);
+  for (size_t i = 0; i < shards; ++i)
+    if (shard_offsets_[i + 1] <= shard_offsets_[i])
+      throw std::runtime_error("invalid Ribbon filter shards in " + filename);
+  solution_.resize(shard_offsets_.back() * result_bits_);
+  fin.read(reinterpret_cast<char*>(solution_.data()),
+           solution_.size() * sizeof(uint64_t));
+  if (!fin)
+    throw std::runtime_error("truncated Ribbon filter in " + filename);
+  hash_ = default_hash_function(seed_);
+}
+
+void ribbon_filter::add(object const&) {
+  throw std::logic_error("cannot add to a static Ribbon filter");
+}
+
+size_t ribbon_filter::lookup(object const& o) const {
+  auto b = make_band(hash_(o));
+  auto first = shard_offsets_[b.shard];
+  auto s = start(b.start_hash, shard_offsets_[b.shard + 1] - first);
+  auto offset = s % band_width;
+  auto lo = &solution_[(first + s / band_width) * result_bits_];
+  auto hi = lo + result_bits_;
+  uint64_t result = 0;
+  for (size_t j = 0; j < result_bits_; ++j) {
+    auto x = lo[j] >> offset;
+    if (offset != 0)
+      x |= hi[j] << (band_width - offset);
+    result |= uint64_t(__builtin_parityll(x & b.coefficients)) << j;
+  }
+  return result == b.result;
+}
+
+size_t ribbon_filter::rows() const {
+  return shard_offsets_.back() * band_width;
+}
+
+size_t ribbon_filter::result_bits() const {
+  return result_bits_;
+}
+
+std::vector<uint64_t> const& ribbon_filter::storage() const {
+  return solution_;
+}
+
+void ribbon_filter::save(std::string const& filename, unsigned long long K,
+                         unsigned long long z, bool canonical) const {
+  std::ofstream fout(filename, std::ios::out | std::ofstream::binary);
+  size_t shards = shard_offsets_.size() - 1;
+  fout.write(uuid_1_0_0.data(), uuid_1_0_0.size());
+  fout.write(reinterpret_cast<const char*>(&K), sizeof(K));
+  fout.write(reinterpret_cast<const char*>(&z), sizeof(z));
+  fout.write(reinterpret_cast<const char*>(&canonical), sizeof(canonical));
+  fout.write(reinterpret_cast<const char*>(&result_bits_),
+             sizeof(result_bits_));
+  fout.write(reinterpret_cast<const char*>(&seed_), sizeof(seed_));
+  fout.write(reinterpret_cast<const char*>(&shards), sizeof(shards));
+  fout.write(reinterpret_cast<const char*>(shard_offsets_.data()),
+             shard_offsets_.size() * sizeof(size_t));
+  fout.write(reinterpret_cast<const char*>(solution_.data()),
+             solution_.size() * sizeof(uint64_t));
+  fout.flush();
+  fout.close();
+}
+
+ribbon_filter::band ribbon_filter::make_band(digest d) const {
+  auto h1 = murmur64(d);
+  auto h2 = murmur64(d ^ 0x9e3779b97f4a7c15ULL);
+  band b;
+  b.shard = mulhi(h1, shard_offsets_.size() - 1);
+  b.start_hash = h2;
+  // The first coefficient is always set, so the band starts at its row.
+  b.coefficients = murmur64(h2 + 0x2545f4914f6cdd1dULL) | 1;
+  b.result = h1 & ((uint64_t(1) << result_bits_) - 1);
+  return b;
+}
+
+void ribbon_filter::build(std::vector<digest> const& digests,
+                          size_t threads) {
+  if (result_bits_ == 0 || result_bits_ > 16)
+    throw std::invalid_argument("Ribbon result bits must be in [1, 16]");
+  auto n = digests.size();
+  auto shards = std::max(size_t(1), std::min(threads, n / min_shard_size));
+  shard_offsets_.assign(shards + 1, 0);
+  std::vector<band> bands(n);
+  detail::parallel_for(n, threads, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i)
+      bands[i] = make_band(digests[i]);
+  });
+  // Group the bands by shard.
+  std::vector<std::vector<band>> groups(shards);
+  for (auto& b : bands)
+    groups[b.shard].push_back(b);
+  bands.clear();
+  bands.shrink_to_fit();
+  std::vector<std::vector<uint64_t>> solutions(shards);
+  std::vector<size_t> blocks(shards);
+  detail::parallel_for(shards, threads, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      auto rows = groups[i].size() * overhead + band_width;
+      blocks[i] = static_cast<size_t>(rows) / band_width + 1;
+      while (!solve(groups[i], blocks[i], solutions[i]))
+        blocks[i] += std::max(size_t(1), blocks[i] / 50);
+    }
+  });
+  for (size_t i = 0; i < shards; ++i)
+    shard_offsets_[i + 1] = shard_offsets_[i] + blocks[i];
+  solution_.resize(shard_offsets_.back() * result_bits_);
+  for (size_t i = 0; i < shards; ++i)
+    std::copy(solutions[i].begin(), solutions[i].end(),
+              solution_.begin() + shard_offsets_[i] * result_bits_);
+}
+
+bool ribbon_filter::solve(std::vector<band>& bands, size_t blocks,
+                          std::vector<uint64_t>& solution) const {
+  auto m = blocks * band_width;
+  // Sorting by start row makes the elimination sweep through memory.
+  std::sort(bands.begin(), bands.end(), [&](band const& x, band const& y) {
+    return x.start_hash < y.start_hash;
+  });
+  // Banded Gaussian elimination: each band is reduced by the rows already
+  // stored until it finds an empty row, which becomes its pivot.
+  std::vector<uint64_t> coefficients(m, 0);
+  std::vector<uint16_t> results(m, 0);
+  for (auto& b : bands) {
+    auto i = start(b.start_hash, blocks);
+    auto c = b.coefficients;
+    auto r = static_cast<uint16_t>(b.result);
+    for (;;) {
+      if (coefficients[i] == 0) {
+        coefficients[i] = c;
+        results[i] = r;
+        break;
+      }
+      c ^= coefficients[i];
+      r ^= results[i];
+      if (c == 0) {
+        // Linearly dependent: fine for a duplicate key, fatal otherwise.
+        if (r == 0)
+          break;
+        return false;
+      }
+      auto shift = __builtin_ctzll(c);
+      c >>= shift;
+      i += shift;
+    }
+  }
+  // Back substitution from the last row upwards. For each result bit, the
+  // window holds the solution bits of the 63 rows following the current one.
+  solution.assign(blocks * result_bits_, 0);
+  std::vector<uint64_t> windows(result_bits_, 0);
+  for (auto i = m; i-- > 0;) {
+    auto words = &solution[(i / band_width) * result_bits_];
+    for (size_t j = 0; j < result_bits_; ++j) {
+      auto w = windows[j] << 1;
+      auto bit = uint64_t(__builtin_parityll(w & coefficients[i]))
+                 ^ ((results[i] >> j) & 1);
+      windows[j] = w | bit;
+      words[j] |= bit << (i % band_width);
+    }
+  }
+  return true;
+}
+
+} // namespace bf
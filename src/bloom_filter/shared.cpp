@@ -0,0 +1,191 @@
+#include <bf/bloom_filter/shared.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bf {
+
+constexpr uint32_t shared_bloom_filter::version;
+
+namespace {
+
+// The header at the start of a segment. The bits follow at a page-aligned
+// offset, so that they can be mapped with their own protection.
+struct segment_header {
+  char magic[8];
+  uint32_t version;
+  // Set last by the creator, so that attachers never see a partial header.
+  uint32_t ready;
+  uint64_t k;
+  uint64_t scheme;
+  uint64_t family;
+  uint64_t seed;
+  uint64_t reduction;
+  uint64_t partition;
+  uint64_t cells;
+  uint64_t offset;
+};
+
+constexpr char segment_magic[8] = {'l', 'i', 'b', 'b', 'f', 's', 'h', 'm'};
+
+size_t page_size() {
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t bits_offset() {
+  auto page = page_size();
+  return (sizeof(segment_header) + page - 1) / page * page;
+}
+
+size_t block_bytes(size_t cells) {
+  auto bits = bitvector::bits_per_block;
+  return (cells + bits - 1) / bits * sizeof(bitvector::block_type);
+}
+
+std::system_error os_error(std::string const& what, std::string const& name) {
+  return std::system_error(errno, std::generic_category(), what + " " + name);
+}
+
+// Closes a descriptor on scope exit; the mapping outlives it.
+struct descriptor {
+  ~descriptor() {
+    if (fd >= 0)
+      close(fd);
+  }
+  int fd;
+};
+
+// Maps a segment and returns the mapping, which unmaps itself when the last
+// view of it goes away.
+std::shared_ptr<void> map_segment(int fd, size_t size, bool writable,
+                                  std::string const& name) {
+  auto prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+  auto p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    throw os_error("cannot map shared memory", name);
+  return std::shared_ptr<void>(p, [size](void* q) { munmap(q, size); });
+}
+
+} // namespace
+
+shared_bloom_filter::shared_bloom_filter(std::string name,
+                                         hasher_config const& config,
+                                         size_t cells, bool partition,
+                                         reduction r)
+    : name_(std::move(name)), writable_(true) {
+  cells = basic_bloom_filter::rounded_cells(config.k, cells, partition, r);
+  auto size = bits_offset() + block_bytes(cells);
+  descriptor d{shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644)};
+  if (d.fd < 0)
+    throw os_error("cannot create shared memory", name_);
+  // The new pages read as zero, which is an empty filter.
+  if (ftruncate(d.fd, static_cast<off_t>(size)) != 0) {
+    auto e = os_error("cannot size shared memory", name_);
+    shm_unlink(name_.c_str());
+    throw e;
+  }
+  std::shared_ptr<void> mapping;
+  try {
+    mapping = map_segment(d.fd, size, true, name_);
+  } catch (...) {
+    shm_unlink(name_.c_str());
+    throw;
+  }
+  auto header = static_cast<segment_header*>(mapping.get());
+  std::memcpy(header->magic, segment_magic, sizeof(segment_magic));
+  header->version = version;
+  header->k = config.k;
+  header->scheme = static_cast<uint64_t>(config.scheme);
+  header->family = static_cast<uint64_t>(config.family);
+  header->seed = config.seed;
+  header->reduction = static_cast<uint64_t>(r);
+  header->partition = partition;
+  header->cells = cells;
+  header->offset = bits_offset();
+  __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+  auto blocks = reinterpret_cast<bitvector::block_type*>(
+    static_cast<char*>(mapping.get()) + header->offset);
+  filter_.reset(new basic_bloom_filter(
+    config, bitvector(blocks, cells, mapping), partition, r));
+  filter_->concurrent(true);
+}
+
+shared_bloom_filter::shared_bloom_filter(std::string name, bool writable)
+    : name_(std::move(name)), writable_(writable) {
+  descriptor d{shm_open(name_.c_str(), writable ? O_RDWR : O_RDONLY, 0)};
+  if (d.fd < 0)
+    throw os_error("cannot open shared memory", name_);
+  struct stat st;
+  if (fstat(d.fd, &st) != 0)
+    throw os_error("cannot inspect shared memory", name_);
+  auto size = static_cast<size_t>(st.st_size);
+  if (size < sizeof(segment_header))
+    throw std::runtime_error("no Bloom filter header in " + name_);
+  auto mapping = map_segment(d.fd, size, writable, name_);
+  auto header = static_cast<segment_header const*>(mapping.get());
+  if (std::memcmp(header->magic, segment_magic, sizeof(segment_magic)) != 0)
+    throw std::runtime_error("no Bloom filter header in " + name_);
+  if (!__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE))
+    throw std::runtime_error("incomplete Bloom filter header in " + name_);
+  if (header->version != version)
+    throw std::runtime_error("unsupported Bloom filter version "
+                             + std::to_string(header->version) + " in "
+                             + name_);
+  if (header->k == 0
+      || header->scheme > static_cast<uint64_t>(hash_scheme::enhanced_double)
+      || header->family > static_cast<uint64_t>(hash_family::wyhash)
+      || header->reduction > static_cast<uint64_t>(reduction::mask))
+    throw std::runtime_error("invalid Bloom filter parameters in " + name_);
+  if (header->offset < sizeof(segment_header)
+      || header->offset % page_size() != 0
+      || size != header->offset + block_bytes(header->cells))
+    throw std::runtime_error("Bloom filter size mismatch in " + name_);
+  hasher_config config(header->k, static_cast<hash_scheme>(header->scheme),
+                       static_cast<hash_family>(header->family),
+                       header->seed);
+  auto blocks = reinterpret_cast<bitvector::block_type*>(
+    static_cast<char*>(mapping.get()) + header->offset);
+  try {
+    filter_.reset(new basic_bloom_filter(
+      config, bitvector(blocks, header->cells, mapping), header->partition != 0,
+      static_cast<reduction>(header->reduction)));
+  } catch (std::invalid_argument const& e) {
+    throw std::runtime_error(std::string(e.what()) + " in " + name_);
+  }
+  filter_->concurrent(true);
+}
+
+void shared_bloom_filter::add(object const& o) {
+  if (!writable_)
+    throw std::logic_error("cannot add to a read-only shared filter");
+  filter_->add(o);
+}
+
+size_t shared_bloom_filter::lookup(object const& o) const {
+  return filter_->lookup(o);
+}
+
+basic_bloom_filter const& shared_bloom_filter::filter() const {
+  return *filter_;
+}
+
+std::string const& shared_bloom_filter::name() const {
+  return name_;
+}
+
+bool shared_bloom_filter::writable() const {
+  return writable_;
+}
+
+bool shared_bloom_filter::remove(std::string const& name) {
+  return shm_unlink(name.c_str()) == 0;
+}
+
+} // namespace bf
@@ -0,0 +1,74 @@
+#include <bf/bloom_filter/stable.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace bf {
+
+size_t stable_bloom_filter::p(double fp, size_t k, size_t cells,
+                              size_t width) {
+  auto max = static_cast<double>((size_t(1) << width) - 1);
+  auto a = std::pow(1 - std::pow(fp, 1.0 / k), 1 / max);
+  auto c = 1.0 / k - 1.0 / cells;
+  auto p = 1 / ((1 / a - 1) * c);
+  return std::max(size_t(1), static_cast<size_t>(std::ceil(p)));
+}
+
+stable_bloom_filter::stable_bloom_filter(size_t k, size_t cells, size_t width,
+                                         size_t evict, uint64_t seed)
+    : hasher_(make_hasher(k)),
+      cells_(cells, width),
+      evict_(std::min(evict, cells)),
+      // The xorshift state must never be zero.
+      state_(seed ^ 0x9e3779b97f4a7c15ULL) {
+  assert(cells > 0);
+  if (state_ == 0)
+    state_ = 0x9e3779b97f4a7c15ULL;
+}
+
+void stable_bloom_filter::add(object const& o) {
+  auto n = cells_.size();
+  auto i = static_cast<size_t>(next() % n);
+  for (size_t j = 0; j < evict_; ++j) {
+    cells_.decrement(i);
+    if (++i == n)
+      i = 0;
+  }
+  auto max = cells_.max();
+  for (auto d : hasher_(o))
+    cells_.set(d % n, max);
+}
+
+size_t stable_bloom_filter::lookup(object const& o) const {
+  for (auto d : hasher_(o))
+    if (cells_.count(d % cells_.size()) == 0)
+      return 0;
+  return 1;
+}
+
+void stable_bloom_filter::clear() {
+  cells_.clear();
+}
+
+counter_vector const& stable_bloom_filter::storage() const {
+  return cells_;
+}
+
+size_t stable_bloom_filter::evict() const {
+  return evict_;
+}
+
+hasher const& stable_bloom_filter::hasher_function() const {
+  return hasher_;
+}
+
+uint64_t stable_bloom_filter::next() {
+  // xorshift64*
+  state_ ^= state_ >> 12;
+  state_ ^= state_ << 25;
+  state_ ^= state_ >> 27;
+  return state_ * 0x2545f4914f6cdd1dULL;
+}
+
+} // namespace bf
@@ -0,0 +1,79 @@
+#include <bf/counter_vector.hpp>
+
+#include <algorithm>
+#include <cassert>
+
+namespace bf {
+
+constexpr size_t counter_vector::bits_per_block;
+
+counter_vector::counter_vector(size_t cells, size_t width)
+    : cells_(cells),
+      width_(width),
+      mask_((block_type(1) << width) - 1),
+      blocks_((cells * width + bits_per_block - 1) / bits_per_block + 1) {
+  assert(width > 0 && width <= 32);
+}
+
+size_t counter_vector::size() const {
+  return cells_;
+}
+
+size_t counter_vector::width() const {
+  return width_;
+}
+
+size_t counter_vector::max() const {
+  return mask_;
+}
+
+size_t counter_vector::count(size_t cell) const {
+  assert(cell < cells_);
+  auto bit = cell * width_;
+  auto block = bit / bits_per_block;
+  auto offset = bit % bits_per_block;
+  auto x = blocks_[block] >> offset;
+  if (offset + width_ > bits_per_block)
+    x |= blocks_[block + 1] << (bits_per_block - offset);
+  return x & mask_;
+}
+
+void counter_vector::set(size_t cell, size_t value) {
+  assert(cell < cells_);
+  assert(value <= mask_);
+  auto bit = cell * width_;
+  auto block = bit / bits_per_block;
+  auto offset = bit % bits_per_block;
+  auto x = static_cast<block_type>(value);
+  blocks_[block] = (blocks_[block] & ~(mask_ << offset)) | (x << offset);
+  if (offset + width_ > bits_per_block) {
+    auto shift = bits_per_block - offset;
+    blocks_[block + 1] = (blocks_[block + 1] & ~(mask_ >> shift)) | (x >> shift);
+  }
+}
+
+bool counter_vector::increment(size_t cell) {
+  auto x = count(cell);
+  if (x == mask_)
+    return false;
+  set(cell, x + 1);
+  return true;
+}
+
+bool counter_vector::decrement(size_t cell) {
+  auto x = count(cell);
+  if (x == 0)
+    return false;
+  set(cell, x - 1);
+  return true;
+}
+
+void counter_vector::clear() {
+  std::fill(blocks_.begin(), blocks_.end(), 0);
+}
+
+std::vector<counter_vector::block_type> const& counter_vector::blocks() const {
+  return blocks_;
+}
+
+} // namespace bf
@@ -1,20 +1,212 @@
 #include <bf/hash.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 
 #include <cassert>
 
 namespace bf {
+namespace {
 
-default_hash_function::default_hash_function(size_t seed) : h3_(seed) {
+inline uint64_t rotl64(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+constexpr uint64_t murmur_c1 = 0x87c37b91114253d5ULL;
+constexpr uint64_t murmur_c2 = 0x4cf5ad432745937fULL;
+
+inline uint64_t mix_k1(uint64_t k1) {
+  k1 *= murmur_c1;
+  k1 = rotl64(k1, 31);
+  return k1 * murmur_c2;
+}
+
+inline uint64_t mix_k2(uint64_t k2) {
+  k2 *= murmur_c2;
+  k2 = rotl64(k2, 33);
+  return k2 * murmur_c1;
+}
+
+// The default secret of wyhash.
+constexpr uint64_t wyp[4] = {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+                             0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL};
+
+inline void wymum(uint64_t& a, uint64_t& b) {
+  auto r = static_cast<unsigned __int128>(a) * b;
+  a = static_cast<uint64_t>(r);
+  b = static_cast<uint64_t>(r >> 64);
+}
+
+inline uint64_t wymix(uint64_t a, uint64_t b) {
+  wymum(a, b);
+  return a ^ b;
+}
+
+inline uint64_t wyr8(uint8_t const* p) {
+  uint64_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+inline uint64_t wyr4(uint8_t const* p) {
+  uint32_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+inline uint64_t wyr3(uint8_t const* p, size_t k) {
+  return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+}
+
+} // namespace
+
+uint64_t wyhash(void const* data, size_t size, uint64_t seed) {
+  auto p = static_cast<uint8_t const*>(data);
+  seed ^= wymix(seed ^ wyp[0], wyp[1]);
+  uint64_t a, b;
+  if (size <= 16) {
+    if (size >= 4) {
+      a = (wyr4(p) << 32) | wyr4(p + ((size >> 3) << 2));
+      b = (wyr4(p + size - 4) << 32) | wyr4(p + size - 4 - ((size >> 3) << 2));
+    } else if (size > 0) {
+      a = wyr3(p, size);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    auto i = size;
+    if (i > 48) {
+      // Three independent lanes keep the multipliers busy on long keys.
+      auto see1 = seed;
+      auto see2 = seed;
+      do {
+        seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+        see1 = wymix(wyr8(p + 16) ^ wyp[2], wyr8(p + 24) ^ see1);
+        see2 = wymix(wyr8(p + 32) ^ wyp[3], wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
+  }
+  a ^= wyp[1];
+  b ^= seed;
+  wymum(a, b);
+  return wymix(a ^ wyp[0] ^ size, b ^ wyp[1]);
+}
+
+std::array<uint64_t, 2> hash128(void const* data, size_t size, uint64_t seed) {
+  auto bytes = static_cast<uint8_t const*>(data);
+  auto blocks = size / 16;
+  uint64_t h1 = seed;
+  uint64_t h2 = seed;
+  for (size_t i = 0; i < blocks; ++i) {
+    uint64_t k1, k2;
+    std::memcpy(&k1, bytes + i * 16, sizeof(k1));
+    std::memcpy(&k2, bytes + i * 16 + 8, sizeof(k2));
+    h1 ^= mix_k1(k1);
+    h1 = rotl64(h1, 27);
+    h1 += h2;
+    h1 = h1 * 5 + 0x52dce729;
+    h2 ^= mix_k2(k2);
+    h2 = rotl64(h2, 31);
+    h2 += h1;
+    h2 = h2 * 5 + 0x38495ab5;
+  }
+  auto tail = bytes + blocks * 16;
+  auto rest = size & 15;
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+  for (auto i = rest; i > 8; --i)
+    k2 ^= uint64_t(tail[i - 1]) << ((i - 9) * 8);
+  if (rest > 8)
+    h2 ^= mix_k2(k2);
+  for (auto i = std::min(rest, size_t(8)); i > 0; --i)
+    k1 ^= uint64_t(tail[i - 1]) << ((i - 1) * 8);
+  if (rest > 0)
+    h1 ^= mix_k1(k1);
+  h1 ^= size;
+  h2 ^= size;
+  h1 += h2;
+  h2 += h1;
+  h1 = detail::murmur64(h1);
+  h2 = detail::murmur64(h2);
+  h1 += h2;
+  h2 += h1;
+  return {{h1, h2}};
+}
+
+default_hash_function::default_hash_function(size_t seed)
+    : h3_(tables(seed)), seed_(seed) {
 }
 
 size_t default_hash_function::operator()(object const& o) const {
-  // FIXME: fall back to a generic universal hash function (e.g., HMAC/MD5) for
-  // too large objects.
   if (o.size() > max_obj_size)
-    throw std::runtime_error("object too large");
-  return o.size() == 0 ? 0 : h3_(o.data(), o.size());
+    return wyhash(o.data(), o.size(), seed_);
+  return o.size() == 0 ? 0 : (*h3_)(o.data(), o.size());
+}
+
+std::shared_ptr<default_hash_function::table_type const>
+default_hash_function::tables(size_t seed) {
+  // Tables are never evicted: a process uses few distinct seeds, and filters
+  // loaded one after another would otherwise regenerate them every time.
+  static std::mutex mutex;
+  static std::map<size_t, std::shared_ptr<table_type const>> cache;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& entry = cache[seed];
+  if (!entry)
+    entry = std::make_shared<table_type>(seed);
+  return entry;
+}
+
+void default_hash_function::operator()(object const* objects, size_t n,
+                                       digest* out, size_t stride) const {
+  constexpr auto lanes = batch_lanes;
+  size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    auto size = objects[i].size();
+    auto uniform = size > 0 && size <= max_obj_size;
+    for (size_t l = 1; l < lanes; ++l)
+      uniform &= objects[i + l].size() == size;
+    if (!uniform) {
+      for (size_t l = 0; l < lanes; ++l)
+        out[(i + l) * stride] = (*this)(objects[i + l]);
+      continue;
+    }
+    unsigned char const* p[lanes];
+    digest r[lanes];
+    for (size_t l = 0; l < lanes; ++l) {
+      p[l] = static_cast<unsigned char const*>(objects[i + l].data());
+      r[l] = 0;
+    }
+    for (size_t b = 0; b < size; ++b) {
+      auto table = h3_->table(b);
+      for (size_t l = 0; l < lanes; ++l)
+        r[l] ^= table[p[l][b]];
+    }
+    for (size_t l = 0; l < lanes; ++l)
+      out[(i + l) * stride] = r[l];
+  }
+  for (; i < n; ++i)
+    out[i * stride] = (*this)(objects[i]);
+}
+
+wyhash_function::wyhash_function(size_t seed) : seed_(seed) {
+}
+
+size_t wyhash_function::operator()(object const& o) const {
+  return wyhash(o.data(), o.size(), seed_);
 }
 
 default_hasher::default_hasher(std::vector<hash_function> fns)
@@ -41,6 +233,98 @@ std::vector<digest> double_hasher::operator()(object const& o) const {
   return d;
 }
 
+enhanced_double_hasher::enhanced_double_hasher(size_t k, size_t seed)
+    : k_(k), seed_(seed) {
+}
+
+std::vector<digest> enhanced_double_hasher::operator()(object const& o) const {
+  auto h = hash128(o.data(), o.size(), seed_);
+  auto a = h[0];
+  auto b = h[1];
+  std::vector<digest> d(k_);
+  for (size_t i = 0; i < d.size(); ++i) {
+    d[i] = a;
+    a += b;
+    b += i + 1;
+  }
+  return d;
+}
+
+batch_hasher::batch_hasher(hasher_config const& config) : config_(config) {
+  assert(config.k > 0);
+  if (config.scheme == hash_scheme::enhanced_double)
+    return;
+  // The seeds follow the same sequence as make_hasher(k, seed, double_hashing).
+  auto functions = config.scheme == hash_scheme::double_hashing ? 2 : config.k;
+  std::minstd_rand0 prng(config.seed);
+  for (size_t i = 0; i < functions; ++i) {
+    auto seed = prng();
+    if (config.family == hash_family::wyhash)
+      seeds_.push_back(seed);
+    else
+      h3_.push_back(std::make_shared<default_hash_function>(seed));
+  }
+}
+
+std::vector<digest> batch_hasher::operator()(object const& o) const {
+  std::vector<digest> d(config_.k);
+  (*this)(&o, 1, d.data());
+  return d;
+}
+
+void batch_hasher::operator()(object const* objects, size_t n,
+                              digest* out) const {
+  auto k = config_.k;
+  switch (config_.scheme) {
+    case hash_scheme::enhanced_double:
+      for (size_t i = 0; i < n; ++i) {
+        auto h = hash128(objects[i].data(), objects[i].size(), config_.seed);
+        auto a = h[0];
+        auto b = h[1];
+        for (size_t j = 0; j < k; ++j) {
+          out[i * k + j] = a;
+          a += b;
+          b += j + 1;
+        }
+      }
+      break;
+    case hash_scheme::double_hashing:
+      base(0, objects, n, out, k);
+      if (k == 1)
+        break;
+      // The second digest is stored in slot 1 until it is expanded.
+      base(1, objects, n, out + 1, k);
+      for (size_t i = 0; i < n; ++i) {
+        auto d1 = out[i * k];
+        auto d2 = out[i * k + 1];
+        for (size_t j = 1; j < k; ++j)
+          out[i * k + j] = d1 + j * d2;
+      }
+      break;
+    default:
+      for (size_t j = 0; j < k; ++j)
+        base(j, objects, n, out + j, k);
+  }
+}
+
+hasher_config const& batch_hasher::config() const {
+  return config_;
+}
+
+void batch_hasher::base(size_t i, object const* objects, size_t n,
+                        digest* out, size_t stride) const {
+  if (!h3_.empty()) {
+    (*h3_[i])(objects, n, out, stride);
+  } else {
+    for (size_t j = 0; j < n; ++j)
+      out[j * stride] = wyhash(objects[j].data(), objects[j].size(), seeds_[i]);
+  }
+}
+
+hasher make_hasher(hasher_config const& config) {
+  return batch_hasher(config);
+}
+
 hasher make_hasher(size_t k, size_t seed, bool double_hashing) {
   assert(k > 0);
   std::minstd_rand0 prng(seed);
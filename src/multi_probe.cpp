@@ -0,0 +1,23 @@
+#include <bf/multi_probe.hpp>
+
+#include <stdexcept>
+
+namespace bf {
+
+bitvector probe(object const& o,
+                std::vector<basic_bloom_filter const*> const& filters) {
+  bitvector result(filters.size());
+  if (filters.empty())
+    return result;
+  auto config = filters[0]->configuration();
+  for (auto f : filters)
+    if (f->configuration() != config)
+      throw std::invalid_argument("filters differ in hasher configuration");
+  auto digests = filters[0]->hasher_function()(o);
+  for (size_t j = 0; j < filters.size(); ++j)
+    if (filters[j]->lookup_digests(digests))
+      result.set(j);
+  return result;
+}
+
+} // namespace bf
@@ -0,0 +1,198 @@
+#include <bf/storage.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+namespace bf {
+
+constexpr size_t huge_page_allocator::huge_page_size;
+
+void* heap_allocator::allocate(size_t bytes) {
+  // calloc obtains large blocks as fresh zero pages without touching them.
+  auto p = std::calloc(bytes == 0 ? 1 : bytes, 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void heap_allocator::deallocate(void* p, size_t) {
+  std::free(p);
+}
+
+namespace {
+
+size_t round_to_huge_pages(size_t bytes) {
+  auto n = huge_page_allocator::huge_page_size;
+  return (bytes + n - 1) / n * n;
+}
+
+} // namespace
+
+void* huge_page_allocator::allocate(size_t bytes) {
+  if (bytes < huge_page_size)
+    return heap_allocator().allocate(bytes);
+  auto size = round_to_huge_pages(bytes);
+  void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if (p == MAP_FAILED) {
+    // No reserved huge pages: over-allocate by one huge page so that the
+    // region can start on a huge page boundary, and ask for transparent
+    // huge pages.
+    auto raw = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+      throw std::bad_alloc();
+    auto address = reinterpret_cast<uintptr_t>(raw);
+    auto aligned = (address + huge_page_size - 1) / huge_page_size
+                   * huge_page_size;
+    auto head = aligned - address;
+    if (head > 0)
+      munmap(raw, head);
+    auto tail = huge_page_size - head;
+    if (tail > 0)
+      munmap(reinterpret_cast<char*>(aligned) + size, tail);
+    p = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+  }
+  return p;
+}
+
+void huge_page_allocator::deallocate(void* p, size_t bytes) {
+  if (bytes < huge_page_size)
+    heap_allocator().deallocate(p, bytes);
+  else
+    munmap(p, round_to_huge_pages(bytes));
+}
+
+arena_allocator::arena_allocator(void* buffer, size_t size)
+    : buffer_(static_cast<char*>(buffer)), size_(size) {
+}
+
+void* arena_allocator::allocate(size_t bytes) {
+  auto address = reinterpret_cast<uintptr_t>(buffer_ + used_);
+  auto padding = (64 - address % 64) % 64;
+  if (padding > size_ - used_ || bytes > size_ - used_ - padding)
+    throw std::bad_alloc();
+  auto p = buffer_ + used_ + padding;
+  used_ += padding + bytes;
+  std::memset(p, 0, bytes);
+  return p;
+}
+
+void arena_allocator::deallocate(void*, size_t) {
+}
+
+size_t arena_allocator::available() const {
+  return size_ - used_;
+}
+
+numa_allocator::numa_allocator(std::vector<size_t> nodes, bool interleave)
+    : nodes_(std::move(nodes)), interleave_(interleave) {
+}
+
+void* numa_allocator::allocate(size_t bytes) {
+  auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  auto size = (std::max(bytes, size_t(1)) + page - 1) / page * page;
+  auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+    throw std::bad_alloc();
+#ifdef __linux__
+  // A preferred-node policy takes a single node.
+  auto count = interleave_ ? nodes_.size() : std::min(nodes_.size(), size_t(1));
+  std::vector<unsigned long> mask;
+  auto bits = sizeof(unsigned long) * 8;
+  for (size_t i = 0; i < count; ++i) {
+    auto node = nodes_[i];
+    if (mask.size() <= node / bits)
+      mask.resize(node / bits + 1, 0);
+    mask[node / bits] |= 1UL << (node % bits);
+  }
+  if (!mask.empty()) {
+    auto mode = interleave_ ? MPOL_INTERLEAVE : MPOL_PREFERRED;
+    // A kernel without NUMA support leaves the default policy.
+    if (syscall(SYS_mbind, p, size, mode, mask.data(), mask.size() * bits + 1, 0) != 0
+        && errno != ENOSYS) {
+      auto e = errno;
+      munmap(p, size);
+      throw std::system_error(e, std::generic_category(), "cannot bind memory to NUMA nodes");
+    }
+  }
+#endif
+  return p;
+}
+
+void numa_allocator::deallocate(void* p, size_t bytes) {
+  auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  munmap(p, (std::max(bytes, size_t(1)) + page - 1) / page * page);
+}
+
+std::vector<size_t> numa_nodes() {
+#ifdef __linux__
+  // The file holds a list of ranges such as "0-1,4".
+  std::vector<size_t> nodes;
+  std::ifstream in("/sys/devices/system/node/online");
+  std::string list;
+  if (in >> list) {
+    std::istringstream ranges(list);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+      auto dash = range.find('-');
+      auto first = std::stoul(range.substr(0, dash));
+      auto last = dash == std::string::npos
+                    ? first : std::stoul(range.substr(dash + 1));
+      for (auto node = first; node <= last; ++node)
+        nodes.push_back(node);
+    }
+  }
+  if (nodes.empty())
+    nodes.push_back(0);
+  return nodes;
+#else
+  return {0};
+#endif
+}
+
+size_t current_numa_node() {
+#ifdef __linux__
+  static thread_local unsigned node = 0;
+  static thread_local unsigned calls = 0;
+  if (calls++ % 256 == 0) {
+    unsigned cpu;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+      node = 0;
+  }
+  return node;
+#else
+  return 0;
+#endif
+}
+
+std::shared_ptr<storage_allocator> const& default_allocator() {
+  static std::shared_ptr<storage_allocator> allocator
+    = std::make_shared<heap_allocator>();
+  return allocator;
+}
+
+} // namespace bf
@@ -15,28 +15,53 @@ trial<nothing> run(config const& cfg) {
     auto numeric = cfg.check("numeric");
     auto k = *cfg.as<size_t>("hash-functions");
     auto cells = *cfg.as<size_t>("cells");
-    // auto seed = *cfg.as<size_t>("seed");
+    auto width = *cfg.as<size_t>("width");
+    auto evict = *cfg.as<size_t>("evict");
+    auto seed = *cfg.as<size_t>("seed");
     auto fpr = *cfg.as<double>("fp-rate");
     auto capacity = *cfg.as<size_t>("capacity");
-    // auto part = cfg.check("partition");
-    // auto double_hashing = cfg.check("double-hashing");
+    auto part = cfg.check("partition");
+    auto conservative = cfg.check("conservative");
+    auto double_hashing = cfg.check("double-hashing");
 
     auto const& type = *cfg.as<std::string>("type");
     std::unique_ptr<bloom_filter> bf;
 
     if (type == "basic") {
-        if (fpr == 0 || capacity == 0) {
-            if (cells == 0)
-                return error{"need non-zero cells"};
-            if (k == 0)
-                return error{"need non-zero k"};
-
-            // auto h = make_hasher(k);
-            bf.reset(new basic_bloom_filter(std::move(k), cells));
-        } else {
-            assert(fpr != 0 && capacity != 0);
-            bf.reset(make_filter_ptr(fpr, capacity));
+        if (fpr != 0 && capacity != 0) {
+            cells = basic_bloom_filter::m(fpr, capacity);
+            k = basic_bloom_filter::k(cells, capacity);
         }
+        if (cells == 0)
+            return error{"need non-zero cells"};
+        if (k == 0)
+            return error{"need non-zero k"};
+        auto scheme = double_hashing ? hash_scheme::double_hashing : hash_scheme::independent;
+        hasher_config config(k, scheme, hash_family::h3, seed);
+        bf.reset(new basic_bloom_filter(config, cells, part));
+    } else if (type == "count-min") {
+        if (cells == 0)
+            return error{"need non-zero cells"};
+        if (k == 0)
+            return error{"need non-zero k"};
+        bf.reset(new count_min_sketch(k, cells, conservative));
+    } else if (type == "cuckoo") {
+        if (capacity == 0)
+            return error{"need non-zero capacity"};
+        bf.reset(new cuckoo_filter(capacity, 16, seed));
+    } else if (type == "stable") {
+        if (cells == 0)
+            return error{"need non-zero cells"};
+        if (k == 0)
+            return error{"need non-zero k"};
+        if (width == 0 || width > 32)
+            return error{"need width between 1 and 32"};
+        if (evict == 0) {
+            if (fpr == 0)
+                return error{"need non-zero evict or fp-rate"};
+            evict = stable_bloom_filter::p(fpr, k, cells, width);
+        }
+        bf.reset(new stable_bloom_filter(k, cells, width, evict, seed));
     } else {
         return error{"invalid bloom filter type"};
     }
@@ -22,13 +22,14 @@ void config::initialize() {
 
   auto& bloomfilter = create_block("bloom filter options");
   bloomfilter
-    .add('t', "type", "basic|counting|spectral-mi|spectral-rm|bitwise|stable")
+    .add('t', "type", "basic|count-min|cuckoo|stable")
     .single();
   bloomfilter.add('f', "fp-rate", "desired false-positive rate").init(0);
   bloomfilter.add('c', "capacity", "max number of expected elements").init(0);
   bloomfilter.add('m', "cells", "number of cells").init(0);
   bloomfilter.add('w', "width", "bits per cells").init(1);
   bloomfilter.add('p', "partition", "enable partitioning");
+  bloomfilter.add('u', "conservative", "conservative update (count-min)");
   bloomfilter.add('e', "evict", "number of cells to evict (stable)").init(0);
   bloomfilter.add('k', "hash-functions", "number of hash functions").init(0);
   bloomfilter.add('d', "double-hashing", "use double-hashing");
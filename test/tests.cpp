@@ -1,8 +1,33 @@
 #include "bf/all.hpp"
 #include "test.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 using namespace bf;
 
+namespace {
+
+// Returns a path in the temporary directory for a file written by a test.
+std::string temp_path(std::string const& name) {
+    char const* dir = std::getenv("TMPDIR");
+    return std::string(dir != nullptr ? dir : "/tmp") + "/libbf-" + std::to_string(getpid()) + "-"
+           + name;
+}
+
+} // namespace
+
 TEST(bloom_filter_basic) {
     const size_t numberOfHashFunctions = 3;
     basic_bloom_filter bf(numberOfHashFunctions, 10000);
@@ -28,7 +53,7 @@ TEST(bloom_filter_basic) {
     // CHECK_EQUAL(bf.lookup("corge"), 1u);
     // CHECK_EQUAL(bf.lookup('a'), 1u);
 
-    std::string filemane = "test.bin";
+    std::string filemane = temp_path("test.bin");
     const unsigned long long K = 31;
     const unsigned long long z = 3;
     const bool canonical = false;
@@ -56,4 +81,1117 @@ TEST(bloom_filter_basic) {
     CHECK_EQUAL(loaded.lookup("qux"), 0u);
     CHECK_EQUAL(loaded.lookup("graunt"), 0u);
     CHECK_EQUAL(loaded.lookup(3.1415), 0u);
+    std::remove(filemane.c_str());
+}
+
+TEST(count_min_sketch) {
+    count_min_sketch cms(4, 1024);
+    for (int i = 0; i < 3; ++i)
+        cms.add("foo");
+    cms.add("bar");
+    CHECK_EQUAL(cms.lookup("foo"), 3u);
+    CHECK_EQUAL(cms.lookup("bar"), 1u);
+    CHECK_EQUAL(cms.lookup("qux"), 0u);
+
+    count_min_sketch conservative(4, 1024, true);
+    conservative.add("foo");
+    conservative.add("bar");
+    conservative.add("bar");
+    CHECK_EQUAL(conservative.lookup("foo"), 1u);
+    CHECK_EQUAL(conservative.lookup("bar"), 2u);
+
+    count_min_sketch other(4, 1024);
+    other.add("foo");
+    other.add("baz");
+    cms.merge(other);
+    CHECK_EQUAL(cms.lookup("foo"), 4u);
+    CHECK_EQUAL(cms.lookup("baz"), 1u);
+
+    cms.clear();
+    CHECK_EQUAL(cms.lookup("foo"), 0u);
+}
+
+TEST(counter_vector) {
+    counter_vector cv(100, 3);
+    CHECK_EQUAL(cv.max(), 7u);
+    for (size_t i = 0; i < cv.size(); ++i)
+        cv.set(i, i % 8);
+    for (size_t i = 0; i < cv.size(); ++i)
+        CHECK_EQUAL(cv.count(i), i % 8);
+    CHECK_EQUAL(cv.increment(7), false);
+    CHECK_EQUAL(cv.decrement(7), true);
+    CHECK_EQUAL(cv.count(7), 6u);
+    CHECK_EQUAL(cv.decrement(8), false);
+    CHECK_EQUAL(cv.count(21), 5u);  // straddles the first two blocks
+}
+
+TEST(bloom_filter_stable) {
+    stable_bloom_filter bf(3, 1000, 3, 0);
+    bf.add("foo");
+    bf.add("bar");
+    CHECK_EQUAL(bf.lookup("foo"), 1u);
+    CHECK_EQUAL(bf.lookup("bar"), 1u);
+    CHECK_EQUAL(bf.lookup("qux"), 0u);
+
+    // With as many evictions as cells, each insertion decrements every cell,
+    // so an element disappears after max() further insertions.
+    stable_bloom_filter evicting(3, 64, 2, 64);
+    evicting.add("foo");
+    CHECK_EQUAL(evicting.lookup("foo"), 1u);
+    for (size_t i = 0; i < evicting.storage().max(); ++i)
+        evicting.add(i);
+    CHECK_EQUAL(evicting.lookup("foo"), 0u);
+    CHECK_EQUAL(stable_bloom_filter::p(0.01, 3, 1000, 3) > 0, true);
+}
+
+TEST(bloom_filter_add_if_absent) {
+    basic_bloom_filter bf(3, 10000);
+    CHECK_EQUAL(bf.add_if_absent("foo"), true);
+    CHECK_EQUAL(bf.add_if_absent("foo"), false);
+    CHECK_EQUAL(bf.add_if_absent(42), true);
+    CHECK_EQUAL(bf.lookup("foo"), 1u);
+    CHECK_EQUAL(bf.lookup(42), 1u);
+
+    // Each element is reported as new by exactly one thread.
+    basic_bloom_filter concurrent(3, 1 << 20);
+    concurrent.concurrent(true);
+    const size_t n = 10000;
+    std::atomic<size_t> fresh{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+        threads.emplace_back([&] {
+            for (size_t i = 0; i < n; ++i)
+                if (concurrent.add_if_absent(i))
+                    ++fresh;
+        });
+    for (auto& t : threads)
+        t.join();
+    size_t present = 0;
+    for (size_t i = 0; i < n; ++i)
+        present += concurrent.lookup(i);
+    CHECK_EQUAL(present, n);
+    CHECK(fresh <= n);
+    CHECK(fresh >= n - 10);  // allow for a few false positives
+}
+
+TEST(cuckoo_filter) {
+    cuckoo_filter cf(1000);
+    cf.add("foo");
+    cf.add("bar");
+    cf.add(42);
+    CHECK_EQUAL(cf.lookup("foo"), 1u);
+    CHECK_EQUAL(cf.lookup("bar"), 1u);
+    CHECK_EQUAL(cf.lookup(42), 1u);
+    CHECK_EQUAL(cf.lookup("qux"), 0u);
+    CHECK_EQUAL(cf.size(), 3u);
+    CHECK_EQUAL(cf.remove("bar"), true);
+    CHECK_EQUAL(cf.lookup("bar"), 0u);
+    CHECK_EQUAL(cf.remove("bar"), false);
+
+    // Fill up to the nominal capacity through the batch path.
+    std::vector<uint64_t> keys(1000);
+    std::vector<object> objects;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = i * 7919;
+        objects.push_back(wrap(keys[i]));
+    }
+    cuckoo_filter batch(keys.size(), 8);
+    CHECK_EQUAL(batch.insert(objects.data(), objects.size()), keys.size());
+    size_t found = 0;
+    for (auto k : keys)
+        found += batch.lookup(k);
+    CHECK_EQUAL(found, keys.size());
+
+    auto filename = temp_path("test.cuckoo");
+    batch.save(filename, 31, 3, true);
+    unsigned long long K, z;
+    bool canonical;
+    cuckoo_filter loaded(filename, K, z, canonical);
+    CHECK_EQUAL(K, 31u);
+    CHECK_EQUAL(z, 3u);
+    CHECK_EQUAL(canonical, true);
+    CHECK_EQUAL(loaded.size(), batch.size());
+    found = 0;
+    for (auto k : keys)
+        found += loaded.lookup(k);
+    CHECK_EQUAL(found, keys.size());
+
+    // A bucket count that is not a power of two is rejected.
+    std::string bytes;
+    {
+        std::ifstream fin(filename, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    }
+    size_t buckets = 3;
+    bytes.replace(69, sizeof(buckets), reinterpret_cast<char const*>(&buckets), sizeof(buckets));
+    {
+        std::ofstream fout(filename, std::ios::binary);
+        fout << bytes;
+    }
+    bool thrown = false;
+    try {
+        cuckoo_filter corrupt(filename, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(filename.c_str());
+}
+
+TEST(binary_fuse_filter) {
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 100000; ++i)
+        keys.push_back(i * 0x9e3779b97f4a7c15ULL);
+    keys.push_back(keys.front());  // duplicates are fine
+    binary_fuse16_filter bf(keys, 4);
+    size_t found = 0;
+    for (auto k : keys)
+        found += bf.lookup(k);
+    CHECK_EQUAL(found, keys.size());
+    CHECK(bf.slots() < 120000u);
+    size_t fp = 0;
+    for (uint64_t i = 0; i < 100000; ++i)
+        fp += bf.lookup(i * 0x9e3779b97f4a7c15ULL + 1);
+    CHECK(fp < 20u);
+
+    auto filename = temp_path("test.fuse");
+    bf.save(filename, 31, 3, false);
+    unsigned long long K, z;
+    bool canonical;
+    binary_fuse16_filter loaded(filename, K, z, canonical);
+    CHECK_EQUAL(K, 31u);
+    CHECK_EQUAL(z, 3u);
+    CHECK_EQUAL(canonical, false);
+    CHECK_EQUAL(loaded.storage() == bf.storage(), true);
+    CHECK_EQUAL(loaded.lookup(keys[42]), 1u);
+
+    // Segments that extend past the fingerprints are rejected.
+    std::string bytes;
+    {
+        std::ifstream fin(filename, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    }
+    size_t segment_count_length;
+    bytes.copy(reinterpret_cast<char*>(&segment_count_length), sizeof(segment_count_length), 85);
+    segment_count_length *= 4;
+    bytes.replace(85, sizeof(segment_count_length), reinterpret_cast<char const*>(&segment_count_length),
+                  sizeof(segment_count_length));
+    {
+        std::ofstream fout(filename, std::ios::binary);
+        fout << bytes;
+    }
+    bool thrown = false;
+    try {
+        binary_fuse16_filter corrupt(filename, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(filename.c_str());
+
+    std::vector<object> objects{wrap("foo"), wrap("bar")};
+    binary_fuse8_filter small(objects);
+    CHECK_EQUAL(small.lookup("foo"), 1u);
+    CHECK_EQUAL(small.lookup("bar"), 1u);
+}
+
+TEST(ribbon_filter) {
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 200000; ++i)
+        keys.push_back(i * 0x9e3779b97f4a7c15ULL);
+    keys.push_back(keys.back());  // duplicates are fine
+    ribbon_filter rf(keys, 8, 4);
+    size_t found = 0;
+    for (auto k : keys)
+        found += rf.lookup(k);
+    CHECK_EQUAL(found, keys.size());
+    CHECK(rf.rows() < 220000u);
+    size_t fp = 0;
+    for (uint64_t i = 0; i < 100000; ++i)
+        fp += rf.lookup(i * 0x9e3779b97f4a7c15ULL + 1);
+    CHECK(fp < 600u);
+
+    auto filename = temp_path("test.ribbon");
+    rf.save(filename, 31, 3, true);
+    unsigned long long K, z;
+    bool canonical;
+    ribbon_filter loaded(filename, K, z, canonical);
+    CHECK_EQUAL(K, 31u);
+    CHECK_EQUAL(canonical, true);
+    CHECK_EQUAL(loaded.storage() == rf.storage(), true);
+    CHECK_EQUAL(loaded.lookup(keys[42]), 1u);
+
+    // Shard offsets must increase.
+    std::string bytes;
+    {
+        std::ifstream fin(filename, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+    }
+    size_t first = 1000000;
+    bytes.replace(77, sizeof(first), reinterpret_cast<char const*>(&first), sizeof(first));
+    {
+        std::ofstream fout(filename, std::ios::binary);
+        fout << bytes;
+    }
+    bool thrown = false;
+    try {
+        ribbon_filter corrupt(filename, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(filename.c_str());
+
+    std::vector<object> objects{wrap("foo"), wrap("bar")};
+    ribbon_filter small(objects, 12);
+    CHECK_EQUAL(small.lookup("foo"), 1u);
+    CHECK_EQUAL(small.lookup("bar"), 1u);
+    CHECK_EQUAL(small.lookup("qux"), 0u);
+}
+
+TEST(quotient_filter) {
+    quotient_filter qf(6, 20);
+    qf.add("foo");
+    qf.add("foo");
+    qf.add("bar");
+    CHECK_EQUAL(qf.lookup("foo"), 2u);
+    CHECK_EQUAL(qf.lookup("bar"), 1u);
+    CHECK_EQUAL(qf.lookup("qux"), 0u);
+    CHECK_EQUAL(qf.remove("foo"), true);
+    CHECK_EQUAL(qf.lookup("foo"), 1u);
+    CHECK_EQUAL(qf.remove("qux"), false);
+    CHECK_EQUAL(qf.size(), 2u);
+
+    // Growing beyond 64 slots doubles the filter transparently.
+    for (uint64_t i = 0; i < 1000; ++i)
+        qf.add(i);
+    CHECK(qf.quotient_bits() > 6u);
+    CHECK_EQUAL(qf.quotient_bits() + qf.remainder_bits(), 26u);
+    size_t found = 0;
+    for (uint64_t i = 0; i < 1000; ++i)
+        found += qf.lookup(i);
+    CHECK_EQUAL(found, 1000u);
+    CHECK_EQUAL(qf.lookup("bar"), 1u);
+
+    quotient_filter other(8, 18);
+    for (uint64_t i = 500; i < 1500; ++i)
+        other.add(i);
+    qf.merge(other);
+    CHECK_EQUAL(qf.size(), 2002u);
+    CHECK_EQUAL(qf.lookup(uint64_t(100)), 1u);
+    CHECK_EQUAL(qf.lookup(uint64_t(700)), 2u);
+    CHECK_EQUAL(qf.lookup(uint64_t(1400)), 1u);
+}
+
+TEST(bit_sliced_index) {
+    basic_bloom_filter a(3, 1024), b(3, 1024), c(3, 1024);
+    a.add("foo");
+    b.add("foo");
+    b.add("bar");
+    c.add("baz");
+    std::vector<std::string> samples
+      = {temp_path("test.sample.0"), temp_path("test.sample.1"), temp_path("test.sample.2")};
+    a.save(samples[0], 31, 3, false);
+    b.save(samples[1], 31, 3, false);
+    c.save(samples[2], 31, 3, false);
+
+    bit_sliced_index index(samples);
+    for (auto& sample : samples)
+        std::remove(sample.c_str());
+    CHECK_EQUAL(index.samples(), 3u);
+    CHECK_EQUAL(index.cells(), 1024u);
+    auto foo = index.lookup("foo");
+    CHECK_EQUAL(foo.size(), 3u);
+    CHECK(foo[0] && foo[1] && !foo[2]);
+    auto bar = index.lookup("bar");
+    CHECK(!bar[0] && bar[1] && !bar[2]);
+    auto qux = index.lookup("qux");
+    CHECK(!qux[0] && !qux[1] && !qux[2]);
+
+    // Many samples span several words per row.
+    std::vector<std::unique_ptr<basic_bloom_filter>> filters;
+    std::vector<basic_bloom_filter const*> pointers;
+    for (int i = 0; i < 100; ++i) {
+        filters.emplace_back(new basic_bloom_filter(3, 4096));
+        filters.back()->add(i);
+        filters.back()->add("all");
+        pointers.push_back(filters.back().get());
+    }
+    bit_sliced_index wide(pointers);
+    auto all = wide.lookup("all");
+    size_t hits = 0;
+    for (size_t i = 0; i < all.size(); ++i)
+        hits += all[i];
+    CHECK_EQUAL(hits, 100u);
+    CHECK(wide.lookup(42)[42]);
+    auto counts = wide.count({wrap(7), wrap(8), wrap("all")});
+    CHECK_EQUAL(counts[7], 2u);
+    CHECK_EQUAL(counts[8], 2u);
+
+    basic_bloom_filter other(3, 2048);
+    pointers.push_back(&other);
+    bool thrown = false;
+    try {
+        bit_sliced_index mismatch(pointers);
+    } catch (std::invalid_argument const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+TEST(multi_filter_probe) {
+    basic_bloom_filter small(3, 512), large(3, 8192), other(3, 2048);
+    small.add("foo");
+    large.add("foo");
+    large.add("bar");
+    other.add("bar");
+    std::vector<basic_bloom_filter const*> filters = {&small, &large, &other};
+    auto foo = probe("foo", filters);
+    CHECK_EQUAL(foo.size(), 3u);
+    CHECK(foo[0] && foo[1] && !foo[2]);
+    auto bar = probe("bar", filters);
+    CHECK(!bar[0] && bar[1] && bar[2]);
+    CHECK_EQUAL(large.lookup_digests(large.hasher_function()(wrap("bar"))), 1u);
+}
+
+TEST(bloom_filter_reduction) {
+    CHECK_EQUAL(reduce(~digest(0), 1000, reduction::fastrange), 999u);
+    CHECK_EQUAL(reduce(digest(0), 1000, reduction::fastrange), 0u);
+    CHECK_EQUAL(reduce(digest(1234), 1024, reduction::mask), 210u);
+    CHECK_EQUAL(reduce(digest(1234), 1000, reduction::modulo), 234u);
+
+    basic_bloom_filter fast(3, 1000);
+    CHECK(fast.reduction_mode() == reduction::fastrange);
+    CHECK_EQUAL(fast.storage().size(), 1000u);
+    basic_bloom_filter masked(3, 1000, false, reduction::mask);
+    CHECK_EQUAL(masked.storage().size(), 1024u);
+    basic_bloom_filter parts(3, 1000, true, reduction::mask);
+    CHECK_EQUAL(parts.storage().size(), 3u * 512);
+
+    // The reduction and partitioning survive a round-trip.
+    for (uint64_t i = 0; i < 100; ++i)
+        parts.add(i);
+    auto v4 = temp_path("test.v4");
+    parts.save(v4, 31, 3, true);
+    bool has_header;
+    unsigned long long K, z;
+    bool canonical;
+    basic_bloom_filter loaded(v4, has_header, K, z, canonical);
+    std::remove(v4.c_str());
+    CHECK(loaded.reduction_mode() == reduction::mask);
+    CHECK(loaded.partitioned());
+    CHECK(loaded.storage() == parts.storage());
+    size_t found = 0;
+    for (uint64_t i = 0; i < 100; ++i)
+        found += loaded.lookup(i);
+    CHECK_EQUAL(found, 100u);
+
+    // A version 3 file reproduces the modulo bit positions.
+    auto digests = make_hasher(2)(wrap("foo"));
+    unsigned long long k = 2;
+    std::vector<uint8_t> bytes(1000 / 8);
+    for (auto d : digests)
+        bytes[(d % 1000) / 8] |= 1 << (d % 1000 % 8);
+    auto v3 = temp_path("test.v3");
+    {
+        std::ofstream out(v3, std::ios::binary);
+        out << "c625b08b-0a6c-4fda-82b6-2e213f4c04f1";
+        out.write(reinterpret_cast<char const*>(&K), sizeof(K));
+        out.write(reinterpret_cast<char const*>(&z), sizeof(z));
+        out.write(reinterpret_cast<char const*>(&canonical), sizeof(canonical));
+        out.write(reinterpret_cast<char const*>(&k), sizeof(k));
+        size_t n = 1000;
+        out.write(reinterpret_cast<char const*>(&n), sizeof(n));
+        out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+    }
+    basic_bloom_filter legacy(v3, has_header, K, z, canonical);
+    std::remove(v3.c_str());
+    CHECK(legacy.reduction_mode() == reduction::modulo);
+    CHECK_EQUAL(legacy.lookup("foo"), 1u);
+}
+
+TEST(enhanced_double_hashing) {
+    std::string fox = "The quick brown fox jumps over the lazy dog";
+    auto h = hash128(fox.data(), fox.size());
+    CHECK_EQUAL(h[0], 0xe34bbc7bbc071b6cULL);
+    CHECK_EQUAL(h[1], 0x7a433ca9c49a9347ULL);
+    auto empty = hash128("", 0);
+    CHECK_EQUAL(empty[0], 0u);
+
+    // Digest i is a + i * b + (i^3 - i) / 6.
+    auto d = make_hasher(hasher_config(4, hash_scheme::enhanced_double))(wrap(fox));
+    CHECK_EQUAL(d.size(), 4u);
+    CHECK_EQUAL(d[0], h[0]);
+    CHECK_EQUAL(d[1], h[0] + h[1]);
+    CHECK_EQUAL(d[2], h[0] + 2 * h[1] + 1);
+    CHECK_EQUAL(d[3], h[0] + 3 * h[1] + 4);
+
+    // Objects of any size can be hashed.
+    std::string large(1000, 'x');
+    basic_bloom_filter bf(hasher_config(7, hash_scheme::enhanced_double), 1 << 16);
+    bf.add(large);
+    for (uint64_t i = 0; i < 1000; ++i)
+        bf.add(i);
+    CHECK_EQUAL(bf.lookup(large), 1u);
+    auto filename = temp_path("test.edh");
+    bf.save(filename, 31, 3, false);
+    bool has_header;
+    unsigned long long K, z;
+    bool canonical;
+    basic_bloom_filter loaded(filename, has_header, K, z, canonical);
+    std::remove(filename.c_str());
+    CHECK(loaded.configuration() == bf.configuration());
+    size_t found = 0;
+    for (uint64_t i = 0; i < 1000; ++i)
+        found += loaded.lookup(i);
+    CHECK_EQUAL(found, 1000u);
+    CHECK_EQUAL(loaded.lookup(large), 1u);
+}
+
+TEST(wyhash_family) {
+    CHECK_EQUAL(wyhash("", 0, 0), 0x93228a4de0eec5a2ULL);
+    CHECK_EQUAL(wyhash("abc", 3, 2), 0xa97f2f7b1d9b3314ULL);
+    std::string digits = "1234567890123456789012345678901234567890"
+                         "1234567890123456789012345678901234567890";
+    CHECK_EQUAL(wyhash(digits.data(), digits.size(), 6), 0x6cc5eab49a92d617ULL);
+
+    // H3 falls back to wyhash for objects it cannot hash.
+    default_hash_function h(42);
+    CHECK_EQUAL(h(wrap(digits)), wyhash(digits.data(), digits.size(), 42));
+
+    basic_bloom_filter bf(hasher_config(3, hash_scheme::double_hashing, hash_family::wyhash), 4096);
+    std::string url = "https://example.org/a/rather/long/path/that/exceeds/36/bytes";
+    bf.add(url);
+    bf.add(digits);
+    CHECK_EQUAL(bf.lookup(url), 1u);
+    CHECK_EQUAL(bf.lookup(digits), 1u);
+    CHECK_EQUAL(bf.lookup("qux"), 0u);
+    auto filename = temp_path("test.wyhash");
+    bf.save(filename, 31, 3, false);
+    bool has_header;
+    unsigned long long K, z;
+    bool canonical;
+    basic_bloom_filter loaded(filename, has_header, K, z, canonical);
+    std::remove(filename.c_str());
+    CHECK(loaded.configuration().family == hash_family::wyhash);
+    CHECK(loaded.configuration().scheme == hash_scheme::double_hashing);
+    CHECK_EQUAL(loaded.lookup(url), 1u);
+}
+
+TEST(batch_hashing) {
+    std::vector<uint64_t> numbers(1000);
+    std::vector<std::string> strings;
+    std::vector<object> objects;
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        numbers[i] = i * 7919;
+        strings.push_back(std::string(i % 50, 'a' + i % 26));
+    }
+    // Uniform runs of integers followed by strings of mixed sizes.
+    for (auto& x : numbers)
+        objects.push_back(wrap(x));
+    for (auto& x : strings)
+        objects.push_back(wrap(x));
+
+    std::vector<hasher_config> configs = {
+        hasher_config(3),
+        hasher_config(4, hash_scheme::double_hashing),
+        hasher_config(1, hash_scheme::double_hashing),
+        hasher_config(5, hash_scheme::enhanced_double),
+        hasher_config(2, hash_scheme::independent, hash_family::wyhash)};
+    for (auto& config : configs) {
+        batch_hasher h(config);
+        std::vector<digest> batch(objects.size() * config.k);
+        h(objects.data(), objects.size(), batch.data());
+        size_t equal = 0;
+        for (size_t i = 0; i < objects.size(); ++i)
+            equal += std::equal(batch.begin() + i * config.k,
+                                batch.begin() + (i + 1) * config.k,
+                                h(objects[i]).begin());
+        CHECK_EQUAL(equal, objects.size());
+    }
+    // The batch hasher reproduces make_hasher(k, 0, double_hashing).
+    auto legacy = make_hasher(4, 0, true)(objects[3]);
+    auto config = batch_hasher(hasher_config(4, hash_scheme::double_hashing))(objects[3]);
+    CHECK(legacy == config);
+
+    basic_bloom_filter bf(3, 1 << 16);
+    bf.add(objects.data(), numbers.size());
+    size_t found = 0;
+    for (auto x : numbers)
+        found += bf.lookup(x);
+    CHECK_EQUAL(found, numbers.size());
+    std::vector<size_t> results(objects.size());
+    bf.lookup(objects.data(), objects.size(), results.data());
+    CHECK_EQUAL(std::count(results.begin(), results.begin() + numbers.size(), 1u),
+                static_cast<std::ptrdiff_t>(numbers.size()));
+    CHECK_EQUAL(results[numbers.size() + 1], bf.lookup(strings[1]));
+}
+
+TEST(shared_h3_tables) {
+    auto tables = default_hash_function::tables(4711);
+    CHECK(tables == default_hash_function::tables(4711));
+    CHECK(tables != default_hash_function::tables(4712));
+    default_hash_function h1(4711), h2(4711);
+    CHECK_EQUAL(h1(wrap("foo")), h2(wrap("foo")));
+    CHECK_EQUAL(h1(wrap("foo")), (*tables)("foo", 3));
+
+    // Constructing many filters reuses the same tables.
+    std::vector<std::unique_ptr<basic_bloom_filter>> filters;
+    for (int i = 0; i < 1000; ++i)
+        filters.emplace_back(new basic_bloom_filter(7, 64));
+    filters[0]->add("foo");
+    CHECK_EQUAL(filters[0]->lookup("foo"), 1u);
+}
+
+TEST(bloom_filter_seed) {
+    hasher_config config(4, hash_scheme::double_hashing, hash_family::h3, 42);
+    basic_bloom_filter seeded(config, 1000, true);
+    CHECK_EQUAL(seeded.storage().size(), 1000u);
+    basic_bloom_filter odd(hasher_config(3), 1000, true);
+    CHECK_EQUAL(odd.storage().size(), 1002u);
+    CHECK(make_hasher(4, 42, true)(wrap("foo")) == seeded.hasher_function()(wrap("foo")));
+    CHECK(make_hasher(4, 0, true)(wrap("foo")) != seeded.hasher_function()(wrap("foo")));
+    for (uint64_t i = 0; i < 200; ++i)
+        seeded.add(i);
+    auto filename = temp_path("test.seed");
+    seeded.save(filename, 31, 3, false);
+    bool has_header;
+    unsigned long long K, z;
+    bool canonical;
+    basic_bloom_filter loaded(filename, has_header, K, z, canonical);
+    std::remove(filename.c_str());
+    CHECK(loaded.configuration() == config);
+    CHECK(loaded.partitioned());
+    size_t found = 0;
+    for (uint64_t i = 0; i < 200; ++i)
+        found += loaded.lookup(i);
+    CHECK_EQUAL(found, 200u);
+}
+
+TEST(partitioned_bloom_filter) {
+    std::unique_ptr<basic_bloom_filter> bf(make_partitioned_filter_ptr(0.01, 100000));
+    CHECK(bf->partitioned());
+    CHECK(bf->reduction_mode() == reduction::mask);
+    auto k = bf->getNumberOfHashFunctions();
+    auto part = bf->storage().size() / k;
+    CHECK_EQUAL(part & (part - 1), 0u);
+
+    std::vector<uint64_t> keys(100000);
+    std::vector<object> objects;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = i * 2654435761u;
+        objects.push_back(wrap(keys[i]));
+    }
+    bf->add(objects.data(), objects.size(), 4);
+    basic_bloom_filter serial(hasher_config(k), bf->storage().size(), true, reduction::mask);
+    for (auto x : keys)
+        serial.add(x);
+    CHECK(serial.storage() == bf->storage());
+
+    // A small filter whose partitions share blocks falls back to atomics.
+    basic_bloom_filter small(3, 100, true);
+    small.add(objects.data(), 10, 4);
+    size_t found = 0;
+    for (size_t i = 0; i < 10; ++i)
+        found += small.lookup(keys[i]);
+    CHECK_EQUAL(found, 10u);
+
+    size_t fp = 0;
+    for (uint64_t i = 0; i < 100000; ++i)
+        fp += bf->lookup(i * 2654435761u + 1);
+    CHECK(fp < 2000);
+}
+
+TEST(storage_allocators) {
+    auto huge = std::make_shared<huge_page_allocator>();
+    basic_bloom_filter bf(hasher_config(3), 1 << 25, false, reduction::fastrange, huge);
+    CHECK(bf.storage().allocator() == huge);
+    bf.add("foo");
+    CHECK_EQUAL(bf.lookup("foo"), 1u);
+    CHECK_EQUAL(bf.lookup("bar"), 0u);
+    auto copy = bf.storage();
+    CHECK(copy == bf.storage());
+    CHECK(copy.allocator() == huge);
+
+    std::vector<char> buffer(4096);
+    auto arena = std::make_shared<arena_allocator>(buffer.data(), buffer.size());
+    basic_bloom_filter small(hasher_config(3), 8000, false, reduction::fastrange, arena);
+    CHECK(arena->available() <= 4096 - 1000);
+    small.add("foo");
+    CHECK_EQUAL(small.lookup("foo"), 1u);
+    bool thrown = false;
+    try {
+        basic_bloom_filter too_large(hasher_config(3), 1 << 16, false, reduction::fastrange, arena);
+    } catch (std::bad_alloc const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+TEST(numa_bloom_filter) {
+    basic_bloom_filter bf(hasher_config(3, hash_scheme::enhanced_double), 1 << 16, true);
+    for (uint64_t i = 0; i < 1000; ++i)
+        bf.add(i);
+    auto nodes = numa_nodes();
+    CHECK(!nodes.empty());
+    CHECK(std::find(nodes.begin(), nodes.end(), current_numa_node()) != nodes.end());
+
+    numa_bloom_filter replicated(bf);
+    CHECK_EQUAL(replicated.replicas(), nodes.size());
+    CHECK(replicated.replica(nodes[0]).storage() == bf.storage());
+    numa_bloom_filter interleaved(bf, numa_bloom_filter::placement::interleave);
+    CHECK_EQUAL(interleaved.replicas(), 1u);
+    size_t found = 0;
+    for (uint64_t i = 0; i < 1000; ++i)
+        found += replicated.lookup(i) + interleaved.lookup(i);
+    CHECK_EQUAL(found, 2000u);
+    CHECK_EQUAL(replicated.lookup(uint64_t(5000)), bf.lookup(uint64_t(5000)));
+}
+
+TEST(shared_bloom_filter) {
+    std::string name = "/libbf-test-shared";
+    shared_bloom_filter::remove(name);
+    shared_bloom_filter owner(name, hasher_config(3, hash_scheme::double_hashing, hash_family::wyhash, 7),
+                              1000, true, reduction::mask);
+    CHECK(owner.writable());
+    CHECK_EQUAL(owner.filter().storage().size(), 3u * 512);
+    for (uint64_t i = 0; i < 100; ++i)
+        owner.add(i);
+
+    shared_bloom_filter reader(name);
+    CHECK(!reader.writable());
+    CHECK(reader.filter().configuration() == owner.filter().configuration());
+    CHECK(reader.filter().partitioned());
+    CHECK(reader.filter().reduction_mode() == reduction::mask);
+    CHECK(reader.filter().storage() == owner.filter().storage());
+    size_t found = 0;
+    for (uint64_t i = 0; i < 100; ++i)
+        found += reader.lookup(i);
+    CHECK_EQUAL(found, 100u);
+    bool thrown = false;
+    try {
+        reader.add(uint64_t(1000));
+    } catch (std::logic_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // Writes through one attachment are visible through the others.
+    shared_bloom_filter writer(name, true);
+    writer.add("foo");
+    CHECK_EQUAL(owner.lookup("foo"), 1u);
+    CHECK_EQUAL(reader.lookup("foo"), 1u);
+
+    thrown = false;
+    try {
+        shared_bloom_filter duplicate(name, hasher_config(3), 1000);
+    } catch (std::system_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(shared_bloom_filter::remove(name));
+    CHECK(!shared_bloom_filter::remove(name));
+    // Attachments outlive the name.
+    CHECK_EQUAL(reader.lookup("foo"), 1u);
+    thrown = false;
+    try {
+        shared_bloom_filter missing(name);
+    } catch (std::system_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // A segment without a valid header is rejected.
+    auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    CHECK(fd >= 0);
+    CHECK_EQUAL(ftruncate(fd, 1 << 16), 0);
+    close(fd);
+    thrown = false;
+    try {
+        shared_bloom_filter garbage(name);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    shared_bloom_filter::remove(name);
+}
+
+TEST(reloadable_bloom_filter) {
+    basic_bloom_filter a(hasher_config(3), 1 << 12);
+    basic_bloom_filter b(hasher_config(4), 1 << 13, true);
+    a.add("foo");
+    b.add("bar");
+    // Swapping exchanges all parameters, as does moving.
+    a.swap(b);
+    CHECK_EQUAL(a.getNumberOfHashFunctions(), 4u);
+    CHECK(a.partitioned());
+    CHECK_EQUAL(a.lookup("bar"), 1u);
+    CHECK_EQUAL(b.getNumberOfHashFunctions(), 3u);
+    CHECK(!b.partitioned());
+    CHECK_EQUAL(b.lookup("foo"), 1u);
+    basic_bloom_filter moved(std::move(a));
+    CHECK_EQUAL(moved.getNumberOfHashFunctions(), 4u);
+    CHECK_EQUAL(moved.lookup("bar"), 1u);
+
+    std::unique_ptr<basic_bloom_filter> first(new basic_bloom_filter(hasher_config(3), 1 << 16));
+    for (uint64_t i = 0; i < 1000; ++i)
+        first->add(i);
+    std::unique_ptr<basic_bloom_filter> second(new basic_bloom_filter(hasher_config(5), 1 << 16));
+    for (uint64_t i = 1000; i < 2000; ++i)
+        second->add(i);
+    auto filename = temp_path("test.reload");
+    second->save(filename, 0, 0, false);
+
+    reloadable_bloom_filter holder(std::move(first));
+    CHECK_EQUAL(holder.lookup(uint64_t(1)), 1u);
+    CHECK_EQUAL(holder.generation(), 0u);
+    std::atomic<bool> done(false);
+    std::atomic<size_t> torn(0);
+    std::thread reader([&] {
+        // Every lookup sees either the old or the new filter in full.
+        while (!done) {
+            uint64_t keys[] = {1, 1001};
+            object objects[] = {wrap(keys[0]), wrap(keys[1])};
+            size_t results[2];
+            holder.lookup(objects, 2, results);
+            if (results[0] + results[1] != 1)
+                ++torn;
+        }
+    });
+    holder.reload(filename).get();
+    std::remove(filename.c_str());
+    done = true;
+    reader.join();
+    CHECK_EQUAL(torn.load(), 0u);
+    CHECK_EQUAL(holder.generation(), 1u);
+    CHECK_EQUAL(holder.lookup(uint64_t(1001)), 1u);
+    CHECK_EQUAL(holder.read([](basic_bloom_filter const& f) { return f.getNumberOfHashFunctions(); }), 5u);
+
+    bool thrown = false;
+    try {
+        holder.reload(temp_path("test.missing")).get();
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK_EQUAL(holder.generation(), 1u);
+}
+
+TEST(bloom_filter_save_async) {
+    basic_bloom_filter bf(hasher_config(3), 1 << 20);
+    for (uint64_t i = 0; i < 10000; ++i)
+        bf.add(i);
+    auto before = bf.storage();
+    auto filename = temp_path("test.async");
+    auto saved = bf.save_async(filename, 31, 5, true);
+    // Adds continue while the snapshot is written.
+    for (uint64_t i = 10000; i < 20000; ++i)
+        bf.add(i);
+    saved.get();
+    bool has_parameters, canonical;
+    unsigned long long K, z;
+    basic_bloom_filter loaded(filename, has_parameters, K, z, canonical);
+    CHECK_EQUAL(K, 31u);
+    CHECK_EQUAL(z, 5u);
+    CHECK(canonical);
+    CHECK(loaded.storage() == before);
+    CHECK(!(loaded.storage() == bf.storage()));
+
+    // A second snapshot captures the later adds.
+    bf.save_async(filename, 31, 5, true).get();
+    basic_bloom_filter reloaded(filename, has_parameters, K, z, canonical);
+    CHECK(reloaded.storage() == bf.storage());
+    std::remove(filename.c_str());
+}
+
+TEST(bloom_filter_delta) {
+    basic_bloom_filter bf(hasher_config(3), 1 << 24);
+    bf.track_changes(true);
+    CHECK(bf.tracking_changes());
+    for (uint64_t i = 0; i < 1000; ++i)
+        bf.add(i);
+    auto base = temp_path("test.base");
+    std::vector<std::string> deltas
+      = {temp_path("test.delta.0"), temp_path("test.delta.1"), temp_path("test.delta.2")};
+    bf.save(base, 0, 0, false);
+    for (uint64_t i = 1000; i < 1100; ++i)
+        bf.add(i);
+    bf.save_delta(deltas[0]);
+    std::vector<uint64_t> keys(100);
+    std::vector<object> objects;
+    for (uint64_t i = 0; i < 100; ++i)
+        keys[i] = 2000 + i;
+    for (auto& key : keys)
+        objects.push_back(wrap(key));
+    bf.add(objects.data(), objects.size());
+    bf.save_delta(deltas[1]);
+    // Only the changed regions are written.
+    std::ifstream delta(deltas[1], std::ios::binary | std::ios::ate);
+    CHECK(static_cast<size_t>(delta.tellg()) < bf.storage().blocks_count() * 8 / 4);
+
+    bool has_parameters, canonical;
+    unsigned long long K, z;
+    basic_bloom_filter restored(base, has_parameters, K, z, canonical);
+    CHECK(!(restored.storage() == bf.storage()));
+    restored.apply_delta(deltas[0]);
+    CHECK_EQUAL(restored.lookup(uint64_t(1050)), 1u);
+    restored.apply_delta(deltas[1]);
+    CHECK(restored.storage() == bf.storage());
+
+    basic_bloom_filter other(hasher_config(3), 1 << 10);
+    bool thrown = false;
+    try {
+        other.apply_delta(deltas[0]);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        other.save_delta(deltas[2]);
+    } catch (std::logic_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(base.c_str());
+    for (auto& d : deltas)
+        std::remove(d.c_str());
+}
+
+TEST(archive) {
+    std::vector<std::unique_ptr<basic_bloom_filter>> filters;
+    filters.emplace_back(new basic_bloom_filter(hasher_config(3), 1000));
+    filters.emplace_back(new basic_bloom_filter(hasher_config(4, hash_scheme::enhanced_double, hash_family::wyhash, 9),
+                                                1 << 16, true, reduction::mask));
+    filters.emplace_back(new basic_bloom_filter(hasher_config(2), 70000));
+    for (size_t j = 0; j < filters.size(); ++j)
+        for (uint64_t i = 0; i < 100; ++i)
+            filters[j]->add(i * filters.size() + j);
+    auto filename = temp_path("test.archive");
+    {
+        archive_writer writer(filename);
+        writer.add("small", *filters[0]);
+        writer.add("partitioned", *filters[1]);
+        writer.add("large", *filters[2]);
+        bool thrown = false;
+        try {
+            writer.add("small", *filters[2]);
+        } catch (std::invalid_argument const&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+    archive a(filename);
+    CHECK_EQUAL(a.size(), 3u);
+    CHECK_EQUAL(a.name(1), "partitioned");
+    CHECK_EQUAL(a.index("large"), 2u);
+    auto view = a.open(a.index("partitioned"));
+    CHECK(view->configuration() == filters[1]->configuration());
+    CHECK(view->partitioned());
+    CHECK(view->reduction_mode() == reduction::mask);
+    CHECK(view->storage() == filters[1]->storage());
+    CHECK_EQUAL(reinterpret_cast<uintptr_t>(view->storage().blocks()) % archive_writer::alignment, 0u);
+    // Adding to a view leaves the archive unchanged.
+    view->add("foo");
+    CHECK_EQUAL(a.open(1)->lookup("foo"), filters[1]->lookup("foo"));
+
+    auto loaded = a.load({2, 0}, 2);
+    CHECK_EQUAL(loaded.size(), 2u);
+    CHECK(loaded[0]->storage() == filters[2]->storage());
+    CHECK(loaded[1]->storage() == filters[0]->storage());
+    CHECK_EQUAL(loaded[1]->lookup(uint64_t(3)), 1u);
+    bool thrown = false;
+    try {
+        a.index("missing");
+    } catch (std::out_of_range const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    // A saved filter is not an archive.
+    auto plain = temp_path("test.plain");
+    filters[0]->save(plain, 0, 0, false);
+    thrown = false;
+    try {
+        archive invalid(plain);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(plain.c_str());
+    std::remove(filename.c_str());
+}
+
+TEST(bloom_filter_serialization) {
+    basic_bloom_filter bf(hasher_config(4, hash_scheme::double_hashing, hash_family::h3, 3), 5000, true);
+    for (uint64_t i = 0; i < 300; ++i)
+        bf.add(i);
+    auto size = bf.serialized_size();
+    std::vector<uint64_t> buffer((size + 7) / 8);
+    auto bytes = reinterpret_cast<uint8_t*>(buffer.data());
+    CHECK_EQUAL(bf.serialize_to(bytes, size, 31, 2, true), size);
+
+    // The buffer holds the file format.
+    auto filename = temp_path("test.serialized");
+    bf.save(filename, 31, 2, true);
+    std::ifstream file(filename, std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::remove(filename.c_str());
+    CHECK(saved == std::string(reinterpret_cast<char*>(bytes), size));
+
+    unsigned long long K, z;
+    bool canonical;
+    basic_bloom_filter view(bytes, size, K, z, canonical);
+    CHECK_EQUAL(K, 31u);
+    CHECK_EQUAL(z, 2u);
+    CHECK(canonical);
+    CHECK(view.configuration() == bf.configuration());
+    CHECK(view.partitioned());
+    CHECK(view.storage() == bf.storage());
+    CHECK(reinterpret_cast<uint8_t const*>(view.storage().blocks()) > bytes);
+    CHECK(reinterpret_cast<uint8_t const*>(view.storage().blocks()) < bytes + size);
+    view.add("foo");
+    basic_bloom_filter again(bytes, size, K, z, canonical);
+    CHECK_EQUAL(again.lookup("foo"), 1u);
+
+    bool thrown = false;
+    try {
+        bf.serialize_to(bytes, size - 1);
+    } catch (std::length_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        basic_bloom_filter truncated(bytes, size - 8, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    thrown = false;
+    try {
+        basic_bloom_filter unaligned(bytes + 1, size - 1, K, z, canonical);
+    } catch (std::invalid_argument const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+TEST(bloom_filter_corrupt_header) {
+    basic_bloom_filter bf(hasher_config(4), 5000, true);
+    bf.add("foo");
+    auto size = bf.serialized_size();
+    std::vector<uint64_t> buffer((size + 7) / 8);
+    auto bytes = reinterpret_cast<uint8_t*>(buffer.data());
+    bf.serialize_to(bytes, size);
+    // The number of hash functions follows the UUID, K, z and canonical.
+    uint64_t* k = reinterpret_cast<uint64_t*>(bytes + 56);
+    CHECK_EQUAL(*k, 4u);
+
+    unsigned long long K, z;
+    bool canonical, has_parameters;
+    auto filename = temp_path("test.corrupt");
+    *k = 0;
+    bool thrown = false;
+    try {
+        basic_bloom_filter view(bytes, size, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    {
+        std::ofstream fout(filename, std::ios::binary);
+        fout.write(reinterpret_cast<char*>(bytes), size);
+    }
+    thrown = false;
+    try {
+        basic_bloom_filter loaded(filename, has_parameters, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    // 5000 partitioned cells cannot be split among 3 hash functions.
+    *k = 3;
+    {
+        std::ofstream fout(filename, std::ios::binary);
+        fout.write(reinterpret_cast<char*>(bytes), size);
+    }
+    thrown = false;
+    try {
+        basic_bloom_filter loaded(filename, has_parameters, K, z, canonical);
+    } catch (std::runtime_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(filename.c_str());
+}
+
+TEST(paged_bloom_filter) {
+    hasher_config config(3, hash_scheme::enhanced_double);
+    basic_bloom_filter reference(config, 1 << 22);
+    std::vector<uint64_t> keys(20000);
+    std::vector<object> objects;
+    for (size_t i = 0; i < keys.size(); ++i)
+        keys[i] = i * 7919;
+    for (auto& key : keys)
+        objects.push_back(wrap(key));
+    reference.add(objects.data(), objects.size() / 2);
+    auto filename = temp_path("test.paged");
+    {
+        // 512 KB of bits in 64 KB pages, of which 2 fit the budget.
+        paged_bloom_filter paged(filename, config, 1 << 22, 128 << 10, 64 << 10);
+        CHECK_EQUAL(paged.cells(), size_t(1) << 22);
+        CHECK_EQUAL(paged.page_capacity(), 2u);
+        paged.add(objects.data(), objects.size() / 2);
+        CHECK(paged.cached_pages() <= 2u);
+        // Each page is loaded once for a sorted batch.
+        CHECK_EQUAL(paged.page_loads(), 8u);
+        paged.add(keys[0]);
+    }
+    // The file is a regular saved filter.
+    bool has_parameters, canonical;
+    unsigned long long K, z;
+    basic_bloom_filter loaded(filename, has_parameters, K, z, canonical);
+    CHECK(loaded.storage() == reference.storage());
+
+    paged_bloom_filter paged(filename, 64 << 10, 64 << 10, false);
+    std::remove(filename.c_str());
+    CHECK(paged.configuration() == config);
+    std::vector<size_t> expected(objects.size()), results(objects.size());
+    reference.lookup(objects.data(), objects.size(), expected.data());
+    paged.lookup(objects.data(), objects.size(), results.data());
+    CHECK(results == expected);
+    CHECK_EQUAL(paged.page_loads(), 8u);
+    CHECK_EQUAL(paged.lookup(keys[1]), 1u);
+    CHECK_EQUAL(paged.lookup(keys[1]), reference.lookup(keys[1]));
+    bool thrown = false;
+    try {
+        paged.add(keys[0]);
+    } catch (std::logic_error const&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+TEST(bloom_filter_simple_save) {
+    // The default reduction must survive a round trip.
+    basic_bloom_filter bf(1, 100003);
+    for (uint64_t i = 0; i < 1000; ++i)
+        bf.add(i);
+    auto filename = temp_path("test.simple");
+    {
+        std::ofstream fout(filename, std::ios::binary);
+        bf.simpleSave(fout);
+    }
+    bool has_parameters, canonical;
+    unsigned long long K, z;
+    basic_bloom_filter loaded(filename, has_parameters, K, z, canonical);
+    std::remove(filename.c_str());
+    CHECK(loaded.reduction_mode() == bf.reduction_mode());
+    CHECK(loaded.configuration() == bf.configuration());
+    CHECK(loaded.storage() == bf.storage());
+    size_t found = 0;
+    for (uint64_t i = 0; i < 1000; ++i)
+        found += loaded.lookup(i);
+    CHECK_EQUAL(found, 1000u);
 }